@@ -930,12 +930,14 @@ border = 0xFFFFFF00
             .prop("spacing", spacing)
             .prop("cross_align", "stretch")
             .children({
-                panel("Components",
-                      tree_panel(demo_tex_handle, design_root, selected_key,
-                                 history, history_idx),
-                      left_w),
+                drawingGroup(panel("Components",
+                                   tree_panel(demo_tex_handle, design_root,
+                                              selected_key, history,
+                                              history_idx),
+                                   left_w)),
                 panel("Workspace", std::move(workspace), center_w),
-                panel("Property", std::move(props_panel_node), right_w),
+                drawingGroup(
+                    panel("Property", std::move(props_panel_node), right_w)),
             })
             .build();
 
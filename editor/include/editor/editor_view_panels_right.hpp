@@ -86,8 +86,8 @@ inline ViewNode props_panel(StateHandle<ViewNode> design_root,
   std::vector<StateHandle<std::string>> field_states;
   field_states.reserve(std::size(items));
   for (const auto &it : items) {
-    field_states.push_back(
-        local_state<std::string>(std::string{"editor:prop:"} + it.key, ""));
+    const std::string field_key = std::string{"editor:prop:"} + it.key;
+    field_states.push_back(local_state<std::string>(field_key, ""));
   }
 
   auto stringify = [&](const PropValue &v, Kind k) -> std::string {
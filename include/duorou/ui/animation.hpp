@@ -0,0 +1,270 @@
+#pragma once
+
+#include <duorou/ui/base_node.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) ||                                     \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DUOROU_ANIMATION_SSE2 1
+#endif
+
+namespace duorou::ui {
+
+enum class AnimationCurve : std::uint8_t {
+  Linear,
+  EaseIn,
+  EaseOut,
+  EaseInOut,
+};
+
+inline AnimationCurve animation_curve_from_name(std::string_view name) {
+  if (name == "linear") {
+    return AnimationCurve::Linear;
+  }
+  if (name == "easeIn") {
+    return AnimationCurve::EaseIn;
+  }
+  if (name == "easeOut") {
+    return AnimationCurve::EaseOut;
+  }
+  return AnimationCurve::EaseInOut;
+}
+
+struct AnimationCurveCoeffs {
+  float a{1.0f};
+  float b{};
+  float c{};
+};
+
+inline AnimationCurveCoeffs animation_curve_coeffs(AnimationCurve curve) {
+  switch (curve) {
+  case AnimationCurve::Linear:
+    return AnimationCurveCoeffs{1.0f, 0.0f, 0.0f};
+  case AnimationCurve::EaseIn:
+    return AnimationCurveCoeffs{0.0f, 1.0f, 0.0f};
+  case AnimationCurve::EaseOut:
+    return AnimationCurveCoeffs{2.0f, -1.0f, 0.0f};
+  case AnimationCurve::EaseInOut:
+    return AnimationCurveCoeffs{0.0f, 3.0f, -2.0f};
+  }
+  return AnimationCurveCoeffs{};
+}
+
+namespace detail {
+
+inline void animation_eval(std::size_t n, float now, const float *begin,
+                           const float *inv_duration, const float *ca,
+                           const float *cb, const float *cc, const float *from,
+                           const float *to, float *progress, float *eased,
+                           float *value) {
+  std::size_t i = 0;
+#if defined(DUOROU_ANIMATION_SSE2)
+  const __m128 vnow = _mm_set1_ps(now);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+  for (; i + 4 <= n; i += 4) {
+    const __m128 raw = _mm_mul_ps(_mm_sub_ps(vnow, _mm_loadu_ps(begin + i)),
+                                  _mm_loadu_ps(inv_duration + i));
+    const __m128 t = _mm_min_ps(_mm_max_ps(raw, zero), one);
+    __m128 e = _mm_add_ps(_mm_loadu_ps(cb + i),
+                          _mm_mul_ps(t, _mm_loadu_ps(cc + i)));
+    e = _mm_mul_ps(t, _mm_add_ps(_mm_loadu_ps(ca + i), _mm_mul_ps(t, e)));
+    const __m128 f = _mm_loadu_ps(from + i);
+    _mm_storeu_ps(progress + i, raw);
+    _mm_storeu_ps(eased + i, e);
+    _mm_storeu_ps(value + i,
+                  _mm_add_ps(f, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(to + i), f), e)));
+  }
+#endif
+  for (; i < n; ++i) {
+    const float raw = (now - begin[i]) * inv_duration[i];
+    const float t = std::min(std::max(raw, 0.0f), 1.0f);
+    const float e = t * (ca[i] + t * (cb[i] + t * cc[i]));
+    progress[i] = raw;
+    eased[i] = e;
+    value[i] = from[i] + (to[i] - from[i]) * e;
+  }
+}
+
+} // namespace detail
+
+class AnimationEngine {
+public:
+  struct Track {
+    std::uint32_t target{};
+    std::uint16_t prop{};
+    bool color{};
+    float from{};
+    float to{};
+    std::uint32_t from_rgba{};
+    std::uint32_t to_rgba{};
+    double start_ms{};
+    double duration_ms{};
+    AnimationCurve curve{AnimationCurve::EaseInOut};
+    PropValue final_value{};
+  };
+
+  std::size_t size() const { return target_.size(); }
+
+  bool empty() const { return target_.empty(); }
+
+  void clear() {
+    target_.clear();
+    prop_.clear();
+    color_.clear();
+    begin_.clear();
+    inv_duration_.clear();
+    ca_.clear();
+    cb_.clear();
+    cc_.clear();
+    from_.clear();
+    to_.clear();
+    from_rgba_.clear();
+    to_rgba_.clear();
+    final_.clear();
+    progress_.clear();
+    eased_.clear();
+    value_.clear();
+  }
+
+  void reserve(std::size_t n) {
+    target_.reserve(n);
+    prop_.reserve(n);
+    color_.reserve(n);
+    begin_.reserve(n);
+    inv_duration_.reserve(n);
+    ca_.reserve(n);
+    cb_.reserve(n);
+    cc_.reserve(n);
+    from_.reserve(n);
+    to_.reserve(n);
+    from_rgba_.reserve(n);
+    to_rgba_.reserve(n);
+    final_.reserve(n);
+  }
+
+  void add(Track t) {
+    if (empty()) {
+      epoch_ms_ = t.start_ms;
+    }
+    const auto k = animation_curve_coeffs(t.curve);
+    target_.push_back(t.target);
+    prop_.push_back(t.prop);
+    color_.push_back(t.color ? 1 : 0);
+    begin_.push_back(static_cast<float>(t.start_ms - epoch_ms_));
+    inv_duration_.push_back(
+        static_cast<float>(1.0 / std::max(1e-6, t.duration_ms)));
+    ca_.push_back(k.a);
+    cb_.push_back(k.b);
+    cc_.push_back(k.c);
+    from_.push_back(t.from);
+    to_.push_back(t.to);
+    from_rgba_.push_back(t.from_rgba);
+    to_rgba_.push_back(t.to_rgba);
+    final_.push_back(std::move(t.final_value));
+  }
+
+  void evaluate(double now_ms) {
+    const auto n = size();
+    progress_.resize(n);
+    eased_.resize(n);
+    value_.resize(n);
+    detail::animation_eval(n, static_cast<float>(now_ms - epoch_ms_),
+                           begin_.data(), inv_duration_.data(), ca_.data(),
+                           cb_.data(), cc_.data(), from_.data(), to_.data(),
+                           progress_.data(), eased_.data(), value_.data());
+  }
+
+  std::uint32_t target(std::size_t i) const { return target_[i]; }
+  std::uint16_t prop(std::size_t i) const { return prop_[i]; }
+  bool color(std::size_t i) const { return color_[i] != 0; }
+  bool started(std::size_t i) const { return progress_[i] >= 0.0f; }
+  bool finished(std::size_t i) const { return progress_[i] >= 1.0f; }
+  float value(std::size_t i) const { return value_[i]; }
+  const PropValue &final_value(std::size_t i) const { return final_[i]; }
+
+  std::uint32_t color_value(std::size_t i) const {
+    const auto a = from_rgba_[i];
+    const auto b = to_rgba_[i];
+    const float e = eased_[i];
+    std::uint32_t out = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+      const float x = static_cast<float>((a >> shift) & 0xFFu);
+      const float y = static_cast<float>((b >> shift) & 0xFFu);
+      const long v = std::lround(x + (y - x) * e);
+      out |= static_cast<std::uint32_t>(std::clamp(v, 0L, 255L)) << shift;
+    }
+    return out;
+  }
+
+  void remove(std::size_t i) {
+    const auto last = size() - 1;
+    if (i != last) {
+      target_[i] = target_[last];
+      prop_[i] = prop_[last];
+      color_[i] = color_[last];
+      begin_[i] = begin_[last];
+      inv_duration_[i] = inv_duration_[last];
+      ca_[i] = ca_[last];
+      cb_[i] = cb_[last];
+      cc_[i] = cc_[last];
+      from_[i] = from_[last];
+      to_[i] = to_[last];
+      from_rgba_[i] = from_rgba_[last];
+      to_rgba_[i] = to_rgba_[last];
+      final_[i] = std::move(final_[last]);
+      if (i < progress_.size() && last < progress_.size()) {
+        progress_[i] = progress_[last];
+        eased_[i] = eased_[last];
+        value_[i] = value_[last];
+      }
+    }
+    target_.pop_back();
+    prop_.pop_back();
+    color_.pop_back();
+    begin_.pop_back();
+    inv_duration_.pop_back();
+    ca_.pop_back();
+    cb_.pop_back();
+    cc_.pop_back();
+    from_.pop_back();
+    to_.pop_back();
+    from_rgba_.pop_back();
+    to_rgba_.pop_back();
+    final_.pop_back();
+    if (progress_.size() > size()) {
+      progress_.resize(size());
+      eased_.resize(size());
+      value_.resize(size());
+    }
+  }
+
+private:
+  double epoch_ms_{};
+  std::vector<std::uint32_t> target_{};
+  std::vector<std::uint16_t> prop_{};
+  std::vector<std::uint8_t> color_{};
+  std::vector<float> begin_{};
+  std::vector<float> inv_duration_{};
+  std::vector<float> ca_{};
+  std::vector<float> cb_{};
+  std::vector<float> cc_{};
+  std::vector<float> from_{};
+  std::vector<float> to_{};
+  std::vector<std::uint32_t> from_rgba_{};
+  std::vector<std::uint32_t> to_rgba_{};
+  std::vector<PropValue> final_{};
+  std::vector<float> progress_{};
+  std::vector<float> eased_{};
+  std::vector<float> value_{};
+};
+
+} // namespace duorou::ui
@@ -1,11 +1,16 @@
 #pragma once
 
+#include <array>
 #include <atomic>
+#include <cstddef>
 #include <cstdint>
 #include <initializer_list>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <type_traits>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <variant>
 #include <vector>
@@ -22,12 +27,65 @@ struct BindingId {
   std::int64_t raw{};
 };
 
+enum class EventKind : std::uint8_t {
+  Click,
+  PointerDown,
+  PointerUp,
+  PointerMove,
+  Focus,
+  Blur,
+  KeyDown,
+  KeyUp,
+  TextInput,
+};
+
+inline constexpr std::size_t kEventKindCount = 9;
+
+inline std::optional<EventKind> event_kind_from_name(std::string_view name) {
+  static constexpr std::array<std::string_view, kEventKindCount> names{
+      "click", "pointer_down", "pointer_up", "pointer_move", "focus",
+      "blur",  "key_down",     "key_up",     "text_input"};
+  for (std::size_t i = 0; i < names.size(); ++i) {
+    if (names[i] == name) {
+      return static_cast<EventKind>(i);
+    }
+  }
+  return std::nullopt;
+}
+
+inline constexpr std::uint16_t event_bit(EventKind kind) {
+  return static_cast<std::uint16_t>(1u << static_cast<unsigned>(kind));
+}
+
+struct NodeEvents {
+  std::uint16_t mask{};
+  std::array<std::uint32_t, kEventKindCount> handlers{};
+
+  bool empty() const { return mask == 0; }
+
+  bool has(EventKind kind) const { return (mask & event_bit(kind)) != 0; }
+
+  std::uint64_t get(EventKind kind) const {
+    return handlers[static_cast<std::size_t>(kind)];
+  }
+
+  void set(EventKind kind, std::uint64_t handler_id) {
+    handlers[static_cast<std::size_t>(kind)] =
+        static_cast<std::uint32_t>(handler_id);
+    if (handler_id != 0) {
+      mask = static_cast<std::uint16_t>(mask | event_bit(kind));
+    } else {
+      mask = static_cast<std::uint16_t>(mask & ~event_bit(kind));
+    }
+  }
+};
+
 struct ViewNode {
   NodeId id{};
   std::string key;
   std::string type;
   Props props;
-  std::unordered_map<std::string, std::uint64_t> events;
+  NodeEvents events;
   std::vector<ViewNode> children;
 };
 
@@ -35,6 +93,45 @@ namespace detail {
 inline std::atomic<NodeId> next_node_id{1};
 } // namespace detail
 
+inline NodeId stable_node_id(NodeId parent, std::string_view key,
+                             std::size_t index, std::string_view type) {
+  std::uint64_t h = parent ^ 14695981039346656037ull;
+  auto mix = [&](std::string_view s) {
+    for (unsigned char c : s) {
+      h ^= static_cast<std::uint64_t>(c);
+      h *= 1099511628211ull;
+    }
+  };
+  if (key.empty()) {
+    h = (h ^ static_cast<std::uint64_t>(index)) * 1099511628211ull;
+  } else {
+    h = (h ^ 0xFFu) * 1099511628211ull;
+    mix(key);
+  }
+  h = (h ^ 0xFEu) * 1099511628211ull;
+  mix(type);
+  return h == 0 ? 1 : h;
+}
+
+namespace detail {
+inline void assign_child_ids(ViewNode &node) {
+  std::unordered_set<NodeId> keyed;
+  for (std::size_t i = 0; i < node.children.size(); ++i) {
+    auto &ch = node.children[i];
+    ch.id = stable_node_id(node.id, ch.key, i, ch.type);
+    if (!ch.key.empty() && !keyed.insert(ch.id).second) {
+      ch.id = stable_node_id(node.id, {}, i, ch.type);
+    }
+    assign_child_ids(ch);
+  }
+}
+} // namespace detail
+
+inline void assign_stable_ids(ViewNode &root) {
+  root.id = stable_node_id(0, root.key, 0, root.type);
+  detail::assign_child_ids(root);
+}
+
 class ViewBuilder {
 public:
   explicit ViewBuilder(std::string type)
@@ -94,8 +191,15 @@ public:
     return *this;
   }
 
-  ViewBuilder &event(std::string name, std::uint64_t handler_id) {
-    node_.events.insert_or_assign(std::move(name), handler_id);
+  ViewBuilder &event(EventKind kind, std::uint64_t handler_id) {
+    node_.events.set(kind, handler_id);
+    return *this;
+  }
+
+  ViewBuilder &event(std::string_view name, std::uint64_t handler_id) {
+    if (const auto kind = event_kind_from_name(name)) {
+      node_.events.set(*kind, handler_id);
+    }
     return *this;
   }
 
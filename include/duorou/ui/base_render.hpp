@@ -1,10 +1,13 @@
 #pragma once
 
 #include <duorou/ui/base_layout.hpp>
+#include <duorou/ui/thread_pool.hpp>
 
 #include <algorithm>
 #include <cmath>
+#include <cstddef>
 #include <cstdint>
+#include <deque>
 #include <optional>
 #include <ostream>
 #include <string>
@@ -68,6 +71,7 @@ struct DrawText {
   std::int64_t sel_start{-1};
   std::int64_t sel_end{-1};
   ColorU8 sel_color{70, 120, 210, 180};
+  std::uint64_t text_hash{};
 };
 
 struct DrawImage {
@@ -75,6 +79,7 @@ struct DrawImage {
   TextureHandle texture{};
   RectF uv{0.0f, 0.0f, 1.0f, 1.0f};
   ColorU8 tint{255, 255, 255, 255};
+  bool premultiplied{};
 };
 
 struct PushClip {
@@ -83,8 +88,24 @@ struct PushClip {
 
 struct PopClip {};
 
-using RenderOp =
-    std::variant<PushClip, PopClip, DrawRect, DrawText, DrawImage>;
+struct PushLayer {
+  RectF rect;
+  std::uint64_t id{};
+  std::uint64_t generation{};
+};
+
+struct PopLayer {};
+
+struct PushTransform {
+  std::uint32_t slot{};
+  float origin_x{};
+  float origin_y{};
+};
+
+struct PopTransform {};
+
+using RenderOp = std::variant<PushClip, PopClip, DrawRect, DrawText, DrawImage,
+                              PushLayer, PopLayer, PushTransform, PopTransform>;
 
 struct Renderer {
   virtual ~Renderer() = default;
@@ -93,6 +114,10 @@ struct Renderer {
   virtual void draw_rect(const DrawRect &r) = 0;
   virtual void draw_text(const DrawText &t) = 0;
   virtual void draw_image(const DrawImage &i) = 0;
+  virtual void push_layer(const PushLayer &) {}
+  virtual void pop_layer(const PopLayer &) {}
+  virtual void push_transform(const PushTransform &) {}
+  virtual void pop_transform(const PopTransform &) {}
 };
 
 inline void render_with(Renderer &renderer, const std::vector<RenderOp> &ops) {
@@ -110,6 +135,14 @@ inline void render_with(Renderer &renderer, const std::vector<RenderOp> &ops) {
             renderer.draw_text(v);
           } else if constexpr (std::is_same_v<T, DrawImage>) {
             renderer.draw_image(v);
+          } else if constexpr (std::is_same_v<T, PushLayer>) {
+            renderer.push_layer(v);
+          } else if constexpr (std::is_same_v<T, PopLayer>) {
+            renderer.pop_layer(v);
+          } else if constexpr (std::is_same_v<T, PushTransform>) {
+            renderer.push_transform(v);
+          } else if constexpr (std::is_same_v<T, PopTransform>) {
+            renderer.pop_transform(v);
           }
         },
         op);
@@ -124,10 +157,86 @@ struct RenderVertex {
   std::uint32_t rgba{};
 };
 
+enum class VertexFormat : std::uint8_t {
+  Float = 0,
+  Compact = 1,
+};
+
+struct CompactVertex {
+  std::int16_t x{};
+  std::int16_t y{};
+  std::uint16_t u{};
+  std::uint16_t v{};
+  std::uint32_t rgba{};
+};
+
+struct CompactVertices {
+  std::vector<CompactVertex> vertices{};
+  float pos_scale{1.0f};
+  float uv_scale{1.0f};
+};
+
+inline bool compact_vertices(const std::vector<RenderVertex> &in,
+                             CompactVertices &out, int max_subpixel_bits = 4,
+                             float max_uv_scale = 16.0f) {
+  float max_pos = 0.0f;
+  float max_uv = 0.0f;
+  for (const auto &v : in) {
+    if (!(v.u >= 0.0f) || !(v.v >= 0.0f)) {
+      return false;
+    }
+    max_pos = std::max({max_pos, std::fabs(v.x), std::fabs(v.y)});
+    max_uv = std::max({max_uv, v.u, v.v});
+  }
+  if (!(max_pos <= 32767.0f) || !(max_uv <= max_uv_scale)) {
+    return false;
+  }
+
+  int bits = std::max(0, max_subpixel_bits);
+  while (bits > 0 && max_pos * static_cast<float>(1 << bits) > 32767.0f) {
+    --bits;
+  }
+  float uv_scale = 1.0f;
+  while (uv_scale < max_uv) {
+    uv_scale *= 2.0f;
+  }
+
+  const float pos_mul = static_cast<float>(1 << bits);
+  const float uv_mul = 65535.0f / uv_scale;
+  out.pos_scale = 1.0f / pos_mul;
+  out.uv_scale = uv_scale;
+  out.vertices.resize(in.size());
+  auto *dst = out.vertices.data();
+  for (std::size_t i = 0; i < in.size(); ++i) {
+    const auto &v = in[i];
+    dst[i].x = static_cast<std::int16_t>(std::lround(v.x * pos_mul));
+    dst[i].y = static_cast<std::int16_t>(std::lround(v.y * pos_mul));
+    dst[i].u = static_cast<std::uint16_t>(std::lround(v.u * uv_mul));
+    dst[i].v = static_cast<std::uint16_t>(std::lround(v.v * uv_mul));
+    dst[i].rgba = v.rgba;
+  }
+  return true;
+}
+
 enum class RenderPipeline : std::uint8_t {
   Color = 0,
   Text = 1,
   Image = 2,
+  Layer = 3,
+};
+
+struct RenderTransform {
+  float dx{};
+  float dy{};
+  float scale{1.0f};
+  float opacity{1.0f};
+};
+
+struct RenderTransformGroup {
+  std::uint32_t slot{};
+  float origin_x{};
+  float origin_y{};
+  RectF clip{};
 };
 
 struct RenderBatch {
@@ -136,12 +245,14 @@ struct RenderBatch {
   RectF scissor{};
   std::size_t first{};
   std::size_t count{};
+  std::uint32_t transform{};
 };
 
 struct RenderTree {
   SizeF viewport{};
   std::vector<RenderVertex> vertices{};
   std::vector<RenderBatch> batches{};
+  std::vector<RenderTransformGroup> transforms{};
 };
 
 struct TextQuad {
@@ -154,6 +265,7 @@ struct TextQuad {
   float u1{};
   float v1{};
   TextureHandle texture{};
+  std::uint32_t layer{};
 };
 
 struct TextLayout {
@@ -163,10 +275,30 @@ struct TextLayout {
   std::vector<float> caret_x{};
 };
 
+inline std::uint64_t text_run_hash(std::string_view text) {
+  std::uint64_t h = 14695981039346656037ull;
+  for (unsigned char c : text) {
+    h ^= static_cast<std::uint64_t>(c);
+    h *= 1099511628211ull;
+  }
+  return h != 0 ? h : 1;
+}
+
 struct TextProvider {
   virtual ~TextProvider() = default;
   virtual bool layout_text(std::string_view text, float font_px,
                            TextLayout &out) = 0;
+
+  virtual const TextLayout *layout_run(std::uint64_t hash,
+                                       std::string_view text, float font_px) {
+    (void)hash;
+    return layout_text(text, font_px, run_scratch_) ? &run_scratch_ : nullptr;
+  }
+
+  virtual bool stable_runs() const { return false; }
+
+protected:
+  TextLayout run_scratch_{};
 };
 
 inline std::uint32_t pack_rgba(ColorU8 c) {
@@ -186,250 +318,422 @@ inline RectF intersect_rect(RectF a, RectF b) {
   return RectF{x0, y0, w, h};
 }
 
-inline RenderTree build_render_tree(const std::vector<RenderOp> &ops,
-                                    SizeF viewport, TextProvider &text) {
-  RenderTree tree;
-  tree.viewport = viewport;
-  tree.vertices.reserve(4096);
-  tree.batches.reserve(256);
+inline RectF apply_render_transform(RectF r, const RenderTransform &t,
+                                    float ox, float oy) {
+  r.x = ox + (r.x - ox) * t.scale + t.dx;
+  r.y = oy + (r.y - oy) * t.scale + t.dy;
+  r.w *= t.scale;
+  r.h *= t.scale;
+  return r;
+}
+
+inline const RenderTransformGroup *
+batch_transform_group(const RenderTree &tree, const RenderBatch &b) {
+  if (b.transform == 0 || b.transform > tree.transforms.size()) {
+    return nullptr;
+  }
+  return &tree.transforms[b.transform - 1];
+}
+
+inline RenderTransform
+batch_transform(const RenderTree &tree, const RenderBatch &b,
+                const std::vector<RenderTransform> &transforms) {
+  const auto *g = batch_transform_group(tree, b);
+  if (!g || g->slot >= transforms.size()) {
+    return RenderTransform{};
+  }
+  return transforms[g->slot];
+}
+
+inline RectF batch_scissor(const RenderTree &tree, const RenderBatch &b,
+                           const std::vector<RenderTransform> &transforms) {
+  const auto *g = batch_transform_group(tree, b);
+  if (!g) {
+    return b.scissor;
+  }
+  return intersect_rect(g->clip,
+                        apply_render_transform(b.scissor,
+                                               batch_transform(tree, b, transforms),
+                                               g->origin_x, g->origin_y));
+}
+
+namespace detail {
 
-  auto utf8_len = [](std::string_view s) -> std::int64_t {
-    std::int64_t n = 0;
-    for (std::size_t i = 0; i < s.size();) {
-      const auto b = static_cast<std::uint8_t>(s[i]);
-      std::size_t adv = 1;
-      if ((b & 0x80) == 0x00) {
-        adv = 1;
-      } else if ((b & 0xE0) == 0xC0) {
-        adv = 2;
-      } else if ((b & 0xF0) == 0xE0) {
-        adv = 3;
-      } else if ((b & 0xF8) == 0xF0) {
-        adv = 4;
+class RenderTreeWriter {
+public:
+  explicit RenderTreeWriter(RenderTree &tree) : tree_{tree} {}
+
+  void set_transform(std::uint32_t transform) { transform_ = transform; }
+
+  void emit(const RenderOp &op, RectF sc, TextProvider *text,
+            const TextLayout *pre_layout = nullptr) {
+    if (const auto *r = std::get_if<DrawRect>(&op)) {
+      rect(r->rect, r->fill, sc);
+    } else if (const auto *t = std::get_if<DrawText>(&op)) {
+      emit_text(*t, t->text, sc, text, pre_layout);
+    } else if (const auto *im = std::get_if<DrawImage>(&op)) {
+      image(im->rect, im->texture, im->uv, im->tint, im->premultiplied, sc);
+    }
+  }
+
+  void rect(RectF r, ColorU8 fill, RectF sc) {
+    quad(RenderPipeline::Color, 0, sc, r.x, r.y, r.x + r.w, r.y + r.h, 0.0f,
+         0.0f, 0.0f, 0.0f, pack_rgba(fill));
+  }
+
+  void image(RectF r, TextureHandle texture, RectF uv, ColorU8 tint,
+             bool premultiplied, RectF sc) {
+    if (texture == 0) {
+      return;
+    }
+    quad(premultiplied ? RenderPipeline::Layer : RenderPipeline::Image,
+         texture, sc, r.x, r.y, r.x + r.w, r.y + r.h, uv.x, uv.y, uv.x + uv.w,
+         uv.y + uv.h, pack_rgba(tint));
+  }
+
+  template <typename Text>
+  void emit_text(const Text &v, std::string_view str, RectF sc,
+                 TextProvider *text, const TextLayout *pre_layout) {
+    if (str.empty()) {
+      if (v.caret_end || v.caret_pos >= 0) {
+        const float caret_h = std::min(v.rect.h, v.font_px * v.caret_h_factor);
+        const float caret_y = v.rect.y + (v.rect.h - caret_h) * v.align_y;
+        caret_rect(v.rect.x, caret_y, v.caret_w, caret_h, v.caret_color, sc);
       }
-      if (i + adv > s.size()) {
-        adv = 1;
+      return;
+    }
+
+    const TextLayout *lp = pre_layout;
+    if (!lp) {
+      if (!text) {
+        return;
+      }
+      lp = text->layout_run(v.text_hash ? v.text_hash : text_run_hash(str), str,
+                            v.font_px);
+      if (!lp) {
+        return;
       }
-      i += adv;
-      ++n;
     }
-    return n;
-  };
+    const auto &layout = *lp;
+    if (!(layout.w > 0.0f) || !(layout.h > 0.0f) || layout.quads.empty()) {
+      return;
+    }
+
+    const float scale = std::min(v.rect.w / layout.w, v.rect.h / layout.h);
+    if (!(scale > 0.0f)) {
+      return;
+    }
+
+    const float draw_w = layout.w * scale;
+    const float draw_h = layout.h * scale;
+    const float ox = v.rect.x + (v.rect.w - draw_w) * v.align_x;
+    const float oy = v.rect.y + (v.rect.h - draw_h) * v.align_y;
 
-  auto rect_eq = [&](RectF a, RectF b) {
+    auto caret_at = [&](std::int64_t pos, std::int64_t len) {
+      if (!layout.caret_x.empty()) {
+        const auto last = static_cast<std::int64_t>(layout.caret_x.size()) - 1;
+        const auto idx = std::max<std::int64_t>(0, std::min(pos, last));
+        return ox + layout.caret_x[static_cast<std::size_t>(idx)] * scale;
+      }
+      const float p = len > 0 ? clampf(static_cast<float>(pos), 0.0f,
+                                       static_cast<float>(len)) /
+                                    static_cast<float>(len)
+                              : 0.0f;
+      return ox + draw_w * p;
+    };
+
+    if (v.sel_start >= 0 && v.sel_end >= 0 && v.sel_start != v.sel_end) {
+      const auto len = utf8_len(str);
+      const auto a = std::max<std::int64_t>(0, std::min(v.sel_start, len));
+      const auto b = std::max<std::int64_t>(0, std::min(v.sel_end, len));
+      const float x0 = caret_at(std::min(a, b), len);
+      const float x1 = caret_at(std::max(a, b), len);
+      const float sel_h = std::min(v.rect.h, v.font_px * v.caret_h_factor * scale);
+      const float sel_y = oy + (draw_h - sel_h) * 0.5f;
+      quad(RenderPipeline::Color, 0, sc, std::min(x0, x1), sel_y,
+           std::max(x0, x1), sel_y + sel_h, 0.0f, 0.0f, 0.0f, 0.0f,
+           pack_rgba(v.sel_color));
+    }
+
+    const auto col = pack_rgba(v.color);
+    for (const auto &q : layout.quads) {
+      const float lu = static_cast<float>(q.layer);
+      quad(RenderPipeline::Text, q.texture, sc, ox + q.x0 * scale,
+           oy + q.y0 * scale, ox + q.x1 * scale, oy + q.y1 * scale, q.u0 + lu,
+           q.v0, q.u1 + lu, q.v1, col);
+    }
+
+    if (v.caret_end || v.caret_pos >= 0) {
+      const float caret_x =
+          v.caret_pos >= 0 ? caret_at(v.caret_pos, utf8_len(str)) : ox + draw_w;
+      const float caret_h =
+          std::min(v.rect.h, v.font_px * v.caret_h_factor * scale);
+      const float caret_y = oy + (draw_h - caret_h) * 0.5f;
+      caret_rect(caret_x, caret_y, v.caret_w, caret_h, v.caret_color, sc);
+    }
+  }
+
+private:
+  static bool rect_eq(RectF a, RectF b) {
     return a.x == b.x && a.y == b.y && a.w == b.w && a.h == b.h;
-  };
-
-  auto ensure_batch = [&](RenderPipeline pipeline, TextureHandle texture,
-                          RectF scissor) -> RenderBatch & {
-    if (tree.batches.empty() ||
-        tree.batches.back().pipeline != pipeline ||
-        tree.batches.back().texture != texture ||
-        !rect_eq(tree.batches.back().scissor, scissor)) {
+  }
+
+  void quad(RenderPipeline pipeline, TextureHandle texture, RectF scissor,
+            float x0, float y0, float x1, float y1, float u0, float v0,
+            float u1, float v1, std::uint32_t rgba) {
+    auto &batches = tree_.batches;
+    if (batches.empty() || batches.back().pipeline != pipeline ||
+        batches.back().texture != texture ||
+        !rect_eq(batches.back().scissor, scissor) ||
+        batches.back().transform != transform_) {
       RenderBatch b;
       b.pipeline = pipeline;
       b.texture = texture;
       b.scissor = scissor;
-      b.first = tree.vertices.size();
+      b.first = tree_.vertices.size();
       b.count = 0;
-      tree.batches.push_back(b);
+      b.transform = transform_;
+      batches.push_back(b);
     }
-    return tree.batches.back();
-  };
-
-  auto push_quad = [&](float x0, float y0, float x1, float y1, float u0, float v0,
-                       float u1, float v1, std::uint32_t rgba) {
-    tree.vertices.push_back(RenderVertex{x0, y0, u0, v0, rgba});
-    tree.vertices.push_back(RenderVertex{x1, y0, u1, v0, rgba});
-    tree.vertices.push_back(RenderVertex{x0, y1, u0, v1, rgba});
-    tree.vertices.push_back(RenderVertex{x0, y1, u0, v1, rgba});
-    tree.vertices.push_back(RenderVertex{x1, y0, u1, v0, rgba});
-    tree.vertices.push_back(RenderVertex{x1, y1, u1, v1, rgba});
-  };
+    auto &vs = tree_.vertices;
+    vs.push_back(RenderVertex{x0, y0, u0, v0, rgba});
+    vs.push_back(RenderVertex{x1, y0, u1, v0, rgba});
+    vs.push_back(RenderVertex{x0, y1, u0, v1, rgba});
+    vs.push_back(RenderVertex{x0, y1, u0, v1, rgba});
+    vs.push_back(RenderVertex{x1, y0, u1, v0, rgba});
+    vs.push_back(RenderVertex{x1, y1, u1, v1, rgba});
+    batches.back().count += 6;
+  }
+
+  void caret_rect(float x, float y, float w, float h, ColorU8 c, RectF sc) {
+    quad(RenderPipeline::Color, 0, sc, x, y, x + w, y + h, 0.0f, 0.0f, 0.0f,
+         0.0f, pack_rgba(c));
+  }
+
+  RenderTree &tree_;
+  std::uint32_t transform_{};
+};
+
+inline void apply_clip_op(const RenderOp &op, std::vector<RectF> &clip_stack,
+                          SizeF viewport) {
+  if (const auto *c = std::get_if<PushClip>(&op)) {
+    clip_stack.push_back(intersect_rect(clip_stack.back(), c->rect));
+  } else if (std::holds_alternative<PopClip>(op)) {
+    clip_stack.pop_back();
+    if (clip_stack.empty()) {
+      clip_stack.push_back(RectF{0.0f, 0.0f, viewport.w, viewport.h});
+    }
+  }
+}
+
+struct RenderTransformTracker {
+  std::vector<RenderTransformGroup> &groups;
+  std::uint32_t current{};
+  std::size_t depth{};
+
+  void push(std::uint32_t slot, float origin_x, float origin_y,
+            std::vector<RectF> &clip_stack) {
+    if (depth++ > 0) {
+      return;
+    }
+    groups.push_back(
+        RenderTransformGroup{slot, origin_x, origin_y, clip_stack.back()});
+    current = static_cast<std::uint32_t>(groups.size());
+    clip_stack.push_back(RectF{-1e9f, -1e9f, 2e9f, 2e9f});
+  }
+
+  void pop(std::vector<RectF> &clip_stack, SizeF viewport) {
+    if (depth == 0 || --depth > 0) {
+      return;
+    }
+    current = 0;
+    clip_stack.pop_back();
+    if (clip_stack.empty()) {
+      clip_stack.push_back(RectF{0.0f, 0.0f, viewport.w, viewport.h});
+    }
+  }
+};
+
+struct RenderOpSource {
+  const std::vector<RenderOp> &ops;
+
+  std::size_t size() const { return ops.size(); }
+
+  void clip(std::size_t i, std::vector<RectF> &stack, SizeF viewport) const {
+    apply_clip_op(ops[i], stack, viewport);
+  }
+
+  void transform(std::size_t i, RenderTransformTracker &t,
+                 std::vector<RectF> &stack, SizeF viewport) const {
+    if (const auto *p = std::get_if<PushTransform>(&ops[i])) {
+      t.push(p->slot, p->origin_x, p->origin_y, stack);
+    } else if (std::holds_alternative<PopTransform>(ops[i])) {
+      t.pop(stack, viewport);
+    }
+  }
+
+  std::string_view text(std::size_t i, float &font_px,
+                        std::uint64_t &hash) const {
+    const auto *t = std::get_if<DrawText>(&ops[i]);
+    if (!t) {
+      return {};
+    }
+    font_px = t->font_px;
+    hash = t->text_hash;
+    return t->text;
+  }
+
+  void emit(std::size_t i, RenderTreeWriter &w, RectF sc, TextProvider *text,
+            const TextLayout *pre) const {
+    w.emit(ops[i], sc, text, pre);
+  }
+};
+
+template <typename Source>
+RenderTree build_render_tree_serial(const Source &src, SizeF viewport,
+                                    TextProvider &text) {
+  RenderTree tree;
+  tree.viewport = viewport;
+  tree.vertices.reserve(4096);
+  tree.batches.reserve(256);
 
   std::vector<RectF> clip_stack;
   clip_stack.reserve(32);
   clip_stack.push_back(RectF{0.0f, 0.0f, viewport.w, viewport.h});
 
-  auto current_clip = [&]() -> RectF {
-    if (clip_stack.empty()) {
-      return RectF{0.0f, 0.0f, viewport.w, viewport.h};
+  RenderTreeWriter writer{tree};
+  RenderTransformTracker transforms{tree.transforms};
+  const auto n = src.size();
+  for (std::size_t i = 0; i < n; ++i) {
+    src.clip(i, clip_stack, viewport);
+    src.transform(i, transforms, clip_stack, viewport);
+    writer.set_transform(transforms.current);
+    src.emit(i, writer, clip_stack.back(), &text, nullptr);
+  }
+  return tree;
+}
+
+inline constexpr std::size_t kParallelRenderMinOps = 8192;
+
+template <typename Source>
+RenderTree build_render_tree_parallel(const Source &src, SizeF viewport,
+                                      TextProvider &text, ThreadPool &pool,
+                                      std::size_t min_chunk_ops) {
+  const auto n = src.size();
+  const auto chunk_ops = std::max<std::size_t>(1, min_chunk_ops);
+  const auto chunks =
+      std::min(pool.size() * 4, (n + chunk_ops - 1) / chunk_ops);
+  if (pool.size() <= 1 || n < kParallelRenderMinOps || chunks <= 1) {
+    return build_render_tree_serial(src, viewport, text);
+  }
+
+  std::vector<RectF> clips(n);
+  std::vector<std::uint32_t> groups(n, 0);
+  std::vector<RenderTransformGroup> transform_groups;
+  std::vector<const TextLayout *> runs(n, nullptr);
+  std::vector<bool> has_text(n, false);
+  std::deque<TextLayout> owned;
+  const bool stable = text.stable_runs();
+  {
+    std::vector<RectF> clip_stack;
+    clip_stack.reserve(32);
+    clip_stack.push_back(RectF{0.0f, 0.0f, viewport.w, viewport.h});
+    RenderTransformTracker transforms{transform_groups};
+    for (std::size_t i = 0; i < n; ++i) {
+      src.clip(i, clip_stack, viewport);
+      src.transform(i, transforms, clip_stack, viewport);
+      clips[i] = clip_stack.back();
+      groups[i] = transforms.current;
+      float font_px = 0.0f;
+      std::uint64_t hash = 0;
+      const auto str = src.text(i, font_px, hash);
+      if (str.empty()) {
+        continue;
+      }
+      has_text[i] = true;
+      const auto *run =
+          text.layout_run(hash ? hash : text_run_hash(str), str, font_px);
+      if (run && !stable) {
+        owned.push_back(*run);
+        run = &owned.back();
+      }
+      runs[i] = run;
     }
-    return clip_stack.back();
-  };
+  }
 
-  for (const auto &op : ops) {
-    std::visit(
-        [&](const auto &v) {
-          using T = std::decay_t<decltype(v)>;
-          if constexpr (std::is_same_v<T, PushClip>) {
-            const auto top = current_clip();
-            clip_stack.push_back(intersect_rect(top, v.rect));
-          } else if constexpr (std::is_same_v<T, PopClip>) {
-            if (!clip_stack.empty()) {
-              clip_stack.pop_back();
-            }
-            if (clip_stack.empty()) {
-              clip_stack.push_back(RectF{0.0f, 0.0f, viewport.w, viewport.h});
-            }
-          } else if constexpr (std::is_same_v<T, DrawRect>) {
-            auto &b = ensure_batch(RenderPipeline::Color, 0, current_clip());
-            push_quad(v.rect.x, v.rect.y, v.rect.x + v.rect.w, v.rect.y + v.rect.h,
-                      0.0f, 0.0f, 0.0f, 0.0f, pack_rgba(v.fill));
-            b.count += 6;
-          } else if constexpr (std::is_same_v<T, DrawText>) {
-            const auto sc = current_clip();
-            if (!v.text.empty()) {
-              TextLayout layout;
-              if (!text.layout_text(v.text, v.font_px, layout)) {
-                return;
-              }
-              if (!(layout.w > 0.0f) || !(layout.h > 0.0f) ||
-                  layout.quads.empty()) {
-                return;
-              }
-
-              const float target_w = v.rect.w;
-              const float target_h = v.rect.h;
-              const float scale =
-                  std::min(target_w / layout.w, target_h / layout.h);
-              if (!(scale > 0.0f)) {
-                return;
-              }
-
-              const float draw_w = layout.w * scale;
-              const float draw_h = layout.h * scale;
-              const float ox = v.rect.x + (v.rect.w - draw_w) * v.align_x;
-              const float oy = v.rect.y + (v.rect.h - draw_h) * v.align_y;
-
-              if (v.sel_start >= 0 && v.sel_end >= 0 &&
-                  v.sel_start != v.sel_end) {
-                const auto len = utf8_len(v.text);
-                const auto a = std::max<std::int64_t>(
-                    0, std::min<std::int64_t>(v.sel_start, len));
-                const auto b = std::max<std::int64_t>(
-                    0, std::min<std::int64_t>(v.sel_end, len));
-                const auto s0 = std::min(a, b);
-                const auto s1 = std::max(a, b);
-                float x0 = ox;
-                float x1 = ox;
-                if (!layout.caret_x.empty()) {
-                  const auto last =
-                      static_cast<std::int64_t>(layout.caret_x.size()) - 1;
-                  const auto i0 =
-                      std::max<std::int64_t>(0, std::min(s0, last));
-                  const auto i1 =
-                      std::max<std::int64_t>(0, std::min(s1, last));
-                  x0 = ox + layout.caret_x[static_cast<std::size_t>(i0)] * scale;
-                  x1 = ox + layout.caret_x[static_cast<std::size_t>(i1)] * scale;
-                } else {
-                  const float p0 =
-                      len > 0 ? clampf(static_cast<float>(s0), 0.0f,
-                                       static_cast<float>(len)) /
-                                    static_cast<float>(len)
-                              : 0.0f;
-                  const float p1 =
-                      len > 0 ? clampf(static_cast<float>(s1), 0.0f,
-                                       static_cast<float>(len)) /
-                                    static_cast<float>(len)
-                              : 0.0f;
-                  x0 = ox + draw_w * p0;
-                  x1 = ox + draw_w * p1;
-                }
-
-                const float sel_h =
-                    std::min(v.rect.h, v.font_px * v.caret_h_factor * scale);
-                const float sel_y = oy + (draw_h - sel_h) * 0.5f;
-                auto &bsel = ensure_batch(RenderPipeline::Color, 0, sc);
-                push_quad(std::min(x0, x1), sel_y, std::max(x0, x1),
-                          sel_y + sel_h, 0.0f, 0.0f, 0.0f, 0.0f,
-                          pack_rgba(v.sel_color));
-                bsel.count += 6;
-              }
-
-              const auto col = pack_rgba(v.color);
-              for (const auto &q : layout.quads) {
-                auto &b = ensure_batch(RenderPipeline::Text, q.texture, sc);
-                const float x0 = ox + q.x0 * scale;
-                const float y0 = oy + q.y0 * scale;
-                const float x1 = ox + q.x1 * scale;
-                const float y1 = oy + q.y1 * scale;
-                push_quad(x0, y0, x1, y1, q.u0, q.v0, q.u1, q.v1, col);
-                b.count += 6;
-              }
-
-              if (v.caret_end || v.caret_pos >= 0) {
-                float caret_x = ox + draw_w;
-                if (v.caret_pos >= 0) {
-                  if (!layout.caret_x.empty()) {
-                    const auto last =
-                        static_cast<std::int64_t>(layout.caret_x.size()) - 1;
-                    const auto idx = std::max<std::int64_t>(
-                        0, std::min<std::int64_t>(v.caret_pos, last));
-                    caret_x = ox + layout.caret_x[static_cast<std::size_t>(idx)] * scale;
-                  } else {
-                    const auto len = utf8_len(v.text);
-                    const auto p =
-                        len > 0 ? clampf(static_cast<float>(v.caret_pos), 0.0f,
-                                         static_cast<float>(len)) /
-                                      static_cast<float>(len)
-                                : 0.0f;
-                    caret_x = ox + draw_w * p;
-                  }
-                }
-                const float caret_h =
-                    std::min(v.rect.h, v.font_px * v.caret_h_factor * scale);
-                const float caret_y = oy + (draw_h - caret_h) * 0.5f;
-                auto &b = ensure_batch(RenderPipeline::Color, 0, sc);
-                push_quad(caret_x, caret_y, caret_x + v.caret_w,
-                          caret_y + caret_h, 0.0f, 0.0f, 0.0f, 0.0f,
-                          pack_rgba(v.caret_color));
-                b.count += 6;
-              }
-            } else if (v.caret_end) {
-              const float scale = 1.0f;
-              const float caret_h =
-                  std::min(v.rect.h, v.font_px * v.caret_h_factor * scale);
-              const float caret_y =
-                  v.rect.y + (v.rect.h - caret_h) * v.align_y;
-              const float caret_x = v.rect.x;
-              auto &b = ensure_batch(RenderPipeline::Color, 0, sc);
-              push_quad(caret_x, caret_y, caret_x + v.caret_w, caret_y + caret_h,
-                        0.0f, 0.0f, 0.0f, 0.0f, pack_rgba(v.caret_color));
-              b.count += 6;
-            } else if (v.caret_pos >= 0) {
-              const float scale = 1.0f;
-              const float caret_h =
-                  std::min(v.rect.h, v.font_px * v.caret_h_factor * scale);
-              const float caret_y =
-                  v.rect.y + (v.rect.h - caret_h) * v.align_y;
-              const float caret_x = v.rect.x;
-              auto &b = ensure_batch(RenderPipeline::Color, 0, sc);
-              push_quad(caret_x, caret_y, caret_x + v.caret_w, caret_y + caret_h,
-                        0.0f, 0.0f, 0.0f, 0.0f, pack_rgba(v.caret_color));
-              b.count += 6;
-            }
-          } else if constexpr (std::is_same_v<T, DrawImage>) {
-          const auto sc = current_clip();
-          if (v.texture == 0) {
-            return;
-          }
-          auto &b = ensure_batch(RenderPipeline::Image, v.texture, sc);
-          const float u0 = v.uv.x;
-          const float v0 = v.uv.y;
-          const float u1 = v.uv.x + v.uv.w;
-          const float v1 = v.uv.y + v.uv.h;
-          push_quad(v.rect.x, v.rect.y, v.rect.x + v.rect.w, v.rect.y + v.rect.h,
-                    u0, v0, u1, v1, pack_rgba(v.tint));
-          b.count += 6;
-        }
-        },
-        op);
+  std::vector<RenderTree> parts(chunks);
+  pool.parallel_for(chunks, [&](std::size_t c) {
+    const auto begin = n * c / chunks;
+    const auto end = n * (c + 1) / chunks;
+    auto &part = parts[c];
+    part.vertices.reserve((end - begin) * 6);
+    RenderTreeWriter writer{part};
+    for (auto i = begin; i < end; ++i) {
+      writer.set_transform(groups[i]);
+      if (!has_text[i]) {
+        src.emit(i, writer, clips[i], nullptr, nullptr);
+      } else if (runs[i]) {
+        src.emit(i, writer, clips[i], nullptr, runs[i]);
+      }
+    }
+  });
+
+  RenderTree tree;
+  tree.viewport = viewport;
+  tree.transforms = std::move(transform_groups);
+  std::size_t total_vertices = 0;
+  std::size_t total_batches = 0;
+  for (const auto &part : parts) {
+    total_vertices += part.vertices.size();
+    total_batches += part.batches.size();
   }
+  tree.vertices.resize(total_vertices);
+  tree.batches.reserve(total_batches);
 
+  std::vector<std::size_t> offsets(chunks, 0);
+  for (std::size_t c = 1; c < chunks; ++c) {
+    offsets[c] = offsets[c - 1] + parts[c - 1].vertices.size();
+  }
+  pool.parallel_for(chunks, [&](std::size_t c) {
+    std::copy(parts[c].vertices.begin(), parts[c].vertices.end(),
+              tree.vertices.begin() + static_cast<std::ptrdiff_t>(offsets[c]));
+  });
+
+  for (std::size_t c = 0; c < chunks; ++c) {
+    for (auto b : parts[c].batches) {
+      b.first += offsets[c];
+      if (!tree.batches.empty()) {
+        auto &last = tree.batches.back();
+        if (last.pipeline == b.pipeline && last.texture == b.texture &&
+            last.transform == b.transform && last.scissor.x == b.scissor.x && last.scissor.y == b.scissor.y &&
+            last.scissor.w == b.scissor.w && last.scissor.h == b.scissor.h) {
+          last.count += b.count;
+          continue;
+        }
+      }
+      tree.batches.push_back(b);
+    }
+  }
   return tree;
 }
 
+} // namespace detail
+
+inline RenderTree build_render_tree(const std::vector<RenderOp> &ops,
+                                    SizeF viewport, TextProvider &text) {
+  return detail::build_render_tree_serial(detail::RenderOpSource{ops},
+                                          viewport, text);
+}
+
+inline RenderTree build_render_tree(const std::vector<RenderOp> &ops,
+                                    SizeF viewport, TextProvider &text,
+                                    ThreadPool &pool,
+                                    std::size_t min_chunk_ops = 512) {
+  return detail::build_render_tree_parallel(detail::RenderOpSource{ops},
+                                            viewport, text, pool,
+                                            min_chunk_ops);
+}
+
 inline std::uint8_t clamp_u8(int v) {
   if (v < 0) {
     return 0;
@@ -548,6 +852,17 @@ inline void dump_render_ops(std::ostream &os,
           } else if constexpr (std::is_same_v<T, DrawImage>) {
             os << "Image [" << v.rect.x << "," << v.rect.y << " " << v.rect.w
                << "x" << v.rect.h << "] tex=" << v.texture << "\n";
+          } else if constexpr (std::is_same_v<T, PushLayer>) {
+            os << "PushLayer [" << v.rect.x << "," << v.rect.y << " "
+               << v.rect.w << "x" << v.rect.h << "] id=" << v.id
+               << " gen=" << v.generation << "\n";
+          } else if constexpr (std::is_same_v<T, PopLayer>) {
+            os << "PopLayer\n";
+          } else if constexpr (std::is_same_v<T, PushTransform>) {
+            os << "PushTransform slot=" << v.slot << " origin=" << v.origin_x
+               << "," << v.origin_y << "\n";
+          } else if constexpr (std::is_same_v<T, PopTransform>) {
+            os << "PopTransform\n";
           }
         },
         op);
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace duorou::ui {
+
+class EventHandler {
+public:
+  static constexpr std::size_t kInlineSize = 64;
+
+  EventHandler() = default;
+
+  template <typename F,
+            typename = std::enable_if_t<
+                !std::is_same_v<std::decay_t<F>, EventHandler> &&
+                std::is_invocable_v<std::decay_t<F> &>>>
+  EventHandler(F &&fn) {
+    using T = std::decay_t<F>;
+    if constexpr (std::is_constructible_v<bool, const T &>) {
+      if (!static_cast<bool>(fn)) {
+        return;
+      }
+    }
+    if constexpr (fits_inline<T>()) {
+      ::new (static_cast<void *>(buf_)) T(std::forward<F>(fn));
+      ops_ = &inline_ops<T>;
+    } else {
+      ::new (static_cast<void *>(buf_)) T *(new T(std::forward<F>(fn)));
+      ops_ = &heap_ops<T>;
+    }
+  }
+
+  EventHandler(const EventHandler &) = delete;
+  EventHandler &operator=(const EventHandler &) = delete;
+
+  EventHandler(EventHandler &&other) noexcept { take(other); }
+
+  EventHandler &operator=(EventHandler &&other) noexcept {
+    if (this != &other) {
+      reset();
+      take(other);
+    }
+    return *this;
+  }
+
+  ~EventHandler() { reset(); }
+
+  explicit operator bool() const { return ops_ != nullptr; }
+
+  void operator()() {
+    assert(ops_ && "calling an empty EventHandler");
+    if (!ops_) {
+      return;
+    }
+    ops_->call(buf_);
+  }
+
+  void reset() {
+    if (ops_) {
+      ops_->destroy(buf_);
+      ops_ = nullptr;
+    }
+  }
+
+  bool is_inline() const { return ops_ && ops_->inline_storage; }
+
+private:
+  struct Ops {
+    void (*call)(void *);
+    void (*move)(void *dst, void *src);
+    void (*destroy)(void *);
+    bool inline_storage;
+  };
+
+  template <typename T> static constexpr bool fits_inline() {
+    return sizeof(T) <= kInlineSize &&
+           alignof(T) <= alignof(std::max_align_t) &&
+           std::is_nothrow_move_constructible_v<T>;
+  }
+
+  template <typename T>
+  static constexpr Ops inline_ops{
+      [](void *p) { (*std::launder(static_cast<T *>(p)))(); },
+      [](void *dst, void *src) {
+        auto *s = std::launder(static_cast<T *>(src));
+        ::new (dst) T(std::move(*s));
+        s->~T();
+      },
+      [](void *p) { std::launder(static_cast<T *>(p))->~T(); },
+      true,
+  };
+
+  template <typename T>
+  static constexpr Ops heap_ops{
+      [](void *p) { (**std::launder(static_cast<T **>(p)))(); },
+      [](void *dst, void *src) {
+        ::new (dst) T *(*std::launder(static_cast<T **>(src)));
+      },
+      [](void *p) { delete *std::launder(static_cast<T **>(p)); },
+      false,
+  };
+
+  void take(EventHandler &other) {
+    if (other.ops_) {
+      other.ops_->move(buf_, other.buf_);
+      ops_ = std::exchange(other.ops_, nullptr);
+    }
+  }
+
+  alignas(std::max_align_t) unsigned char buf_[kInlineSize];
+  const Ops *ops_{};
+};
+
+} // namespace duorou::ui
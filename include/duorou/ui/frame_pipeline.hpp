@@ -0,0 +1,345 @@
+#pragma once
+
+#include <duorou/ui/render_commands.hpp>
+#include <duorou/ui/runtime.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace duorou::ui {
+
+inline double pipeline_now() {
+  using clock = std::chrono::steady_clock;
+  return std::chrono::duration<double>(clock::now().time_since_epoch()).count();
+}
+
+enum class InputEventKind {
+  PointerDown,
+  PointerUp,
+  PointerMove,
+  Scroll,
+  KeyDown,
+  KeyUp,
+  TextInput,
+  Resize,
+};
+
+struct PointerSample {
+  double time{};
+  float x{};
+  float y{};
+};
+
+struct InputEvent {
+  InputEventKind kind{InputEventKind::PointerMove};
+  double time{};
+  int pointer{};
+  float x{};
+  float y{};
+  float delta{};
+  int key{};
+  int scancode{};
+  int mods{};
+  std::string text{};
+  std::uint32_t coalesced{};
+  std::vector<PointerSample> history{};
+};
+
+inline double input_first_time(const InputEvent &e) {
+  return e.history.empty() ? e.time : e.history.front().time;
+}
+
+inline bool input_velocity(const InputEvent &e, float &vx, float &vy) {
+  if (e.history.empty()) {
+    return false;
+  }
+  const auto &first = e.history.front();
+  const double dt = e.time - first.time;
+  if (!(dt > 0.0)) {
+    return false;
+  }
+  vx = static_cast<float>((e.x - first.x) / dt);
+  vy = static_cast<float>((e.y - first.y) / dt);
+  return true;
+}
+
+inline bool dispatch_input(ViewInstance &app, InputEvent &e) {
+  switch (e.kind) {
+  case InputEventKind::PointerDown:
+    return app.dispatch_pointer_down(e.pointer, e.x, e.y);
+  case InputEventKind::PointerUp:
+    return app.dispatch_pointer_up(e.pointer, e.x, e.y);
+  case InputEventKind::PointerMove: {
+    float vx = 0.0f;
+    float vy = 0.0f;
+    if (input_velocity(e, vx, vy)) {
+      app.set_pointer_velocity(e.pointer, vx, vy);
+    }
+    return app.dispatch_pointer_move(e.pointer, e.x, e.y);
+  }
+  case InputEventKind::Scroll:
+    return app.dispatch_scroll(e.x, e.y, e.delta);
+  case InputEventKind::KeyDown:
+    return app.dispatch_key_down(e.key, e.scancode, e.mods);
+  case InputEventKind::KeyUp:
+    return app.dispatch_key_up(e.key, e.scancode, e.mods);
+  case InputEventKind::TextInput:
+    return app.dispatch_text_input(std::move(e.text));
+  case InputEventKind::Resize:
+    app.set_viewport(SizeF{e.x, e.y});
+    return true;
+  }
+  return false;
+}
+
+class InputQueue {
+public:
+  static constexpr std::size_t kMaxHistory = 16;
+
+  void push(InputEvent e) {
+    if (e.time == 0.0) {
+      e.time = pipeline_now();
+    }
+    {
+      std::lock_guard<std::mutex> lock{mu_};
+      if (events_.empty() || !coalesce(events_.back(), e)) {
+        events_.push_back(std::move(e));
+      }
+    }
+    cv_.notify_one();
+  }
+
+  void drain(std::vector<InputEvent> &out) {
+    out.clear();
+    std::lock_guard<std::mutex> lock{mu_};
+    out.swap(events_);
+  }
+
+  void wake() {
+    {
+      std::lock_guard<std::mutex> lock{mu_};
+      woken_ = true;
+    }
+    cv_.notify_one();
+  }
+
+  template <typename Rep, typename Period>
+  bool wait_for(std::chrono::duration<Rep, Period> timeout) {
+    std::unique_lock<std::mutex> lock{mu_};
+    const bool ready = cv_.wait_for(
+        lock, timeout, [&] { return woken_ || !events_.empty(); });
+    woken_ = false;
+    return ready;
+  }
+
+private:
+  static bool coalesce(InputEvent &prev, const InputEvent &e) {
+    if (prev.kind != e.kind || prev.pointer != e.pointer) {
+      return false;
+    }
+    if (e.kind == InputEventKind::Scroll) {
+      if (prev.x != e.x || prev.y != e.y) {
+        return false;
+      }
+      prev.delta += e.delta;
+    } else if (e.kind != InputEventKind::PointerMove) {
+      return false;
+    }
+    if (prev.history.size() >= kMaxHistory) {
+      prev.history.erase(prev.history.begin());
+    }
+    prev.history.push_back(PointerSample{prev.time, prev.x, prev.y});
+    prev.time = e.time;
+    prev.x = e.x;
+    prev.y = e.y;
+    ++prev.coalesced;
+    return true;
+  }
+
+  std::mutex mu_;
+  std::condition_variable cv_;
+  std::vector<InputEvent> events_;
+  bool woken_{};
+};
+
+inline double dispatch_queued_input(ViewInstance &app, InputQueue &input,
+                                    std::vector<InputEvent> &scratch) {
+  input.drain(scratch);
+  double earliest = -1.0;
+  StateTransaction tx;
+  for (auto &e : scratch) {
+    const double t = input_first_time(e);
+    if (earliest < 0.0 || t < earliest) {
+      earliest = t;
+    }
+    dispatch_input(app, e);
+  }
+  return earliest;
+}
+
+struct FrameSnapshot {
+  std::uint64_t frame{};
+  SizeF viewport{};
+  RenderCommandBuffer commands{};
+  std::vector<RenderTransform> transforms{};
+  double input_time{-1.0};
+  double build_begin{};
+  double build_end{};
+  std::size_t ops_emitted{};
+  std::size_t ops_reused{};
+  std::size_t nodes_culled{};
+  std::size_t ops_culled{};
+  std::size_t ops_occluded{};
+  std::size_t duplicate_keys{};
+};
+
+using FrameSnapshotPtr = std::shared_ptr<const FrameSnapshot>;
+
+class FrameSnapshotPool {
+public:
+  static constexpr std::size_t kMaxSnapshots = 4;
+
+  bool empty() const { return items_.empty(); }
+
+  std::shared_ptr<FrameSnapshot> acquire() {
+    for (const auto &s : items_) {
+      if (s.use_count() == 1) {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return s;
+      }
+    }
+    auto s = std::make_shared<FrameSnapshot>();
+    if (items_.size() < kMaxSnapshots) {
+      items_.push_back(s);
+    }
+    return s;
+  }
+
+private:
+  std::vector<std::shared_ptr<FrameSnapshot>> items_;
+};
+
+template <typename T> class BoundedQueue {
+public:
+  explicit BoundedQueue(std::size_t capacity) : capacity_{std::max<std::size_t>(1, capacity)} {}
+
+  bool push(T v) {
+    std::unique_lock<std::mutex> lock{mu_};
+    not_full_.wait(lock, [&] { return closed_ || items_.size() < capacity_; });
+    if (closed_) {
+      return false;
+    }
+    items_.push_back(std::move(v));
+    not_empty_.notify_one();
+    return true;
+  }
+
+  template <typename Rep, typename Period>
+  bool pop_for(T &out, std::chrono::duration<Rep, Period> timeout) {
+    std::unique_lock<std::mutex> lock{mu_};
+    if (!not_empty_.wait_for(lock, timeout,
+                             [&] { return closed_ || !items_.empty(); }) ||
+        items_.empty()) {
+      return false;
+    }
+    out = std::move(items_.front());
+    items_.pop_front();
+    not_full_.notify_one();
+    return true;
+  }
+
+  void close() {
+    std::lock_guard<std::mutex> lock{mu_};
+    closed_ = true;
+    not_full_.notify_all();
+    not_empty_.notify_all();
+  }
+
+  bool closed() {
+    std::lock_guard<std::mutex> lock{mu_};
+    return closed_;
+  }
+
+private:
+  std::size_t capacity_{};
+  std::mutex mu_;
+  std::condition_variable not_full_;
+  std::condition_variable not_empty_;
+  std::deque<T> items_;
+  bool closed_{};
+};
+
+struct FrameLatency {
+  std::size_t frames{};
+  std::size_t input_frames{};
+  double build_ms{};
+  double queue_ms{};
+  double input_ms{};
+  double max_input_ms{};
+
+  void record(const FrameSnapshot &s, double draw_begin, double present) {
+    ++frames;
+    build_ms += (s.build_end - s.build_begin) * 1000.0;
+    queue_ms += std::max(0.0, draw_begin - s.build_end) * 1000.0;
+    if (s.input_time >= 0.0) {
+      const double ms = (present - s.input_time) * 1000.0;
+      ++input_frames;
+      input_ms += ms;
+      max_input_ms = std::max(max_input_ms, ms);
+    }
+  }
+
+  double avg_build_ms() const { return frames ? build_ms / frames : 0.0; }
+  double avg_queue_ms() const { return frames ? queue_ms / frames : 0.0; }
+  double avg_input_ms() const {
+    return input_frames ? input_ms / input_frames : 0.0;
+  }
+
+  void reset() { *this = FrameLatency{}; }
+};
+
+inline void capture_frame(FrameSnapshot &s, ViewInstance &app,
+                          bool occlusion) {
+  s.viewport = app.viewport();
+  s.commands.assign(app.render_ops());
+  s.transforms = app.render_transforms();
+  s.ops_emitted = app.render_cache().emitted_nodes;
+  s.ops_reused = app.render_cache().reused_nodes;
+  s.nodes_culled = app.render_cache().culled_nodes;
+  s.ops_culled = app.render_cache().culled_ops;
+  s.ops_occluded = occlusion ? s.commands.cull_occluded() : 0;
+  s.duplicate_keys = app.duplicate_key_count();
+}
+
+inline FrameSnapshotPtr produce_frame(ViewInstance &app, InputQueue &input,
+                                      std::vector<InputEvent> &scratch,
+                                      std::uint64_t frame,
+                                      FrameSnapshotPool &pool,
+                                      bool occlusion = false) {
+  const double begin = pipeline_now();
+  const double input_time = dispatch_queued_input(app, input, scratch);
+  const auto r = app.update();
+  if (!pool.empty() && input_time < 0.0 && !r.rebuilt && !r.layout_rebuilt &&
+      !r.render_rebuilt && !r.transforms_changed) {
+    return {};
+  }
+  auto s = pool.acquire();
+  s->frame = frame;
+  s->build_begin = begin;
+  s->input_time = input_time;
+  capture_frame(*s, app, occlusion);
+  s->build_end = pipeline_now();
+  return s;
+}
+
+} // namespace duorou::ui
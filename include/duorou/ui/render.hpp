@@ -6,9 +6,12 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <iterator>
 #include <ostream>
 #include <string_view>
 #include <type_traits>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -63,6 +66,8 @@ inline void apply_scale_about(RenderOp &op, float ox, float oy, float s) {
         using T = std::decay_t<decltype(v)>;
         if constexpr (std::is_same_v<T, PushClip>) {
           v.rect = apply_scale_about(v.rect, ox, oy, s);
+        } else if constexpr (std::is_same_v<T, PushLayer>) {
+          v.rect = apply_scale_about(v.rect, ox, oy, s);
         } else if constexpr (std::is_same_v<T, DrawRect>) {
           v.rect = apply_scale_about(v.rect, ox, oy, s);
         } else if constexpr (std::is_same_v<T, DrawText>) {
@@ -76,24 +81,51 @@ inline void apply_scale_about(RenderOp &op, float ox, float oy, float s) {
       op);
 }
 
-inline void build_render_ops(const ViewNode &v, const LayoutNode &l,
-                             float parent_opacity, float parent_ox,
-                             float parent_oy, std::vector<RenderOp> &out) {
-  const bool clip = prop_as_bool(v.props, "clip", false);
-  const float opacity =
-      parent_opacity * prop_as_float(v.props, "opacity", 1.0f);
-  const float ox = parent_ox + prop_as_float(v.props, "render_offset_x", 0.0f);
-  const float oy = parent_oy + prop_as_float(v.props, "render_offset_y", 0.0f);
-  const float render_scale = prop_as_float(v.props, "render_scale", 1.0f);
+namespace detail {
 
-  const RectF frame = apply_offset(l.frame, ox, oy);
+inline bool same_rect(RectF a, RectF b) {
+  return a.x == b.x && a.y == b.y && a.w == b.w && a.h == b.h;
+}
 
-  const auto start_all = out.size();
-  if (clip) {
-    out.push_back(PushClip{frame});
-  }
+inline bool outside_clip(RectF r, RectF clip) {
+  return r.x >= clip.x + clip.w || r.y >= clip.y + clip.h ||
+         r.x + r.w <= clip.x || r.y + r.h <= clip.y;
+}
 
-  const auto start0 = out.size();
+inline std::uint32_t render_transform_slot(const ViewNode &v) {
+  const auto *pv = find_prop(v.props, "render_transform");
+  const auto *i = pv ? std::get_if<std::int64_t>(pv) : nullptr;
+  return i && *i > 0 ? static_cast<std::uint32_t>(*i) : 0;
+}
+
+inline bool cullable_node(const ViewNode &v, float render_scale, bool scaled) {
+  return !scaled && render_scale == 1.0f && prop_as_bool(v.props, "cull", true);
+}
+
+inline std::size_t cull_clipped_ops(std::vector<RenderOp> &ops,
+                                    std::size_t begin, RectF clip) {
+  const auto first = ops.begin() + static_cast<std::ptrdiff_t>(begin);
+  const auto it = std::remove_if(first, ops.end(), [&](const RenderOp &op) {
+    return std::visit(
+        [&](const auto &v) {
+          using T = std::decay_t<decltype(v)>;
+          if constexpr (std::is_same_v<T, DrawRect> ||
+                        std::is_same_v<T, DrawText> ||
+                        std::is_same_v<T, DrawImage>) {
+            return outside_clip(v.rect, clip);
+          } else {
+            return false;
+          }
+        },
+        op);
+  });
+  const auto culled = static_cast<std::size_t>(ops.end() - it);
+  ops.erase(it, ops.end());
+  return culled;
+}
+
+inline void emit_node_content_ops(const ViewNode &v, const LayoutNode &l,
+                                  std::vector<RenderOp> &out) {
   emit_render_ops_box(v, l, out);
   emit_render_ops_divider(v, l, out);
   emit_render_ops_checkbox(v, l, out);
@@ -106,6 +138,18 @@ inline void build_render_ops(const ViewNode &v, const LayoutNode &l,
   emit_render_ops_image(v, l, out);
   emit_render_ops_canvas(v, l, out);
   emit_render_ops_text(v, l, out);
+}
+
+inline void emit_node_overlay_ops(const ViewNode &v, const LayoutNode &l,
+                                  std::vector<RenderOp> &out) {
+  emit_render_ops_scrollview(v, l, out);
+}
+
+inline void emit_node_ops_pre(const ViewNode &v, const LayoutNode &l,
+                              float opacity, float ox, float oy,
+                              std::vector<RenderOp> &out) {
+  const auto start0 = out.size();
+  emit_node_content_ops(v, l, out);
   for (std::size_t i = start0; i < out.size(); ++i) {
     apply_opacity(out[i], opacity);
     std::visit(
@@ -117,20 +161,22 @@ inline void build_render_ops(const ViewNode &v, const LayoutNode &l,
             op.rect = apply_offset(op.rect, ox, oy);
           } else if constexpr (std::is_same_v<T, DrawText>) {
             op.rect = apply_offset(op.rect, ox, oy);
+            if (op.text_hash == 0) {
+              op.text_hash = text_run_hash(op.text);
+            }
           } else if constexpr (std::is_same_v<T, DrawImage>) {
             op.rect = apply_offset(op.rect, ox, oy);
           }
         },
         out[i]);
   }
+}
 
-  const auto n = std::min(v.children.size(), l.children.size());
-  for (std::size_t i = 0; i < n; ++i) {
-    build_render_ops(v.children[i], l.children[i], opacity, ox, oy, out);
-  }
-
+inline void emit_node_ops_post(const ViewNode &v, const LayoutNode &l,
+                               float opacity, float ox, float oy,
+                               std::vector<RenderOp> &out) {
   const auto start1 = out.size();
-  emit_render_ops_scrollview(v, l, out);
+  emit_node_overlay_ops(v, l, out);
   for (std::size_t i = start1; i < out.size(); ++i) {
     apply_opacity(out[i], opacity);
     std::visit(
@@ -140,16 +186,76 @@ inline void build_render_ops(const ViewNode &v, const LayoutNode &l,
             op.rect = apply_offset(op.rect, ox, oy);
           } else if constexpr (std::is_same_v<T, DrawText>) {
             op.rect = apply_offset(op.rect, ox, oy);
+            if (op.text_hash == 0) {
+              op.text_hash = text_run_hash(op.text);
+            }
           } else if constexpr (std::is_same_v<T, DrawImage>) {
             op.rect = apply_offset(op.rect, ox, oy);
           }
         },
         out[i]);
   }
+}
+
+inline void build_render_ops(const ViewNode &v, const LayoutNode &l,
+                             float parent_opacity, float parent_ox,
+                             float parent_oy, const RectF *cull_rect,
+                             std::vector<RenderOp> &out) {
+  const bool clip = prop_as_bool(v.props, "clip", false);
+  const auto slot = render_transform_slot(v);
+  const float opacity =
+      parent_opacity * (slot ? 1.0f : prop_as_float(v.props, "opacity", 1.0f));
+  const float ox =
+      parent_ox + (slot ? 0.0f : prop_as_float(v.props, "render_offset_x", 0.0f));
+  const float oy =
+      parent_oy + (slot ? 0.0f : prop_as_float(v.props, "render_offset_y", 0.0f));
+  const float render_scale =
+      slot ? 1.0f : prop_as_float(v.props, "render_scale", 1.0f);
+
+  const RectF frame = apply_offset(l.frame, ox, oy);
+  const bool cull = cull_rect && !slot && cullable_node(v, render_scale, false);
+  if (cull && clip && outside_clip(frame, *cull_rect)) {
+    return;
+  }
+
+  const auto start_all = out.size();
+  if (slot) {
+    out.push_back(PushTransform{slot, frame.x, frame.y});
+  }
+  if (clip) {
+    out.push_back(PushClip{frame});
+  }
+
+  auto start = out.size();
+  emit_node_ops_pre(v, l, opacity, ox, oy, out);
+  if (cull) {
+    cull_clipped_ops(out, start, *cull_rect);
+  }
+
+  RectF inner{};
+  const RectF *child_cull = render_scale == 1.0f && !slot ? cull_rect : nullptr;
+  if (child_cull && clip) {
+    inner = intersect_rect(*child_cull, frame);
+    child_cull = &inner;
+  }
+  const auto n = std::min(v.children.size(), l.children.size());
+  for (std::size_t i = 0; i < n; ++i) {
+    build_render_ops(v.children[i], l.children[i], opacity, ox, oy, child_cull,
+                     out);
+  }
+
+  start = out.size();
+  emit_node_ops_post(v, l, opacity, ox, oy, out);
+  if (cull) {
+    cull_clipped_ops(out, start, *cull_rect);
+  }
 
   if (clip) {
     out.push_back(PopClip{});
   }
+  if (slot) {
+    out.push_back(PopTransform{});
+  }
 
   if (render_scale != 1.0f) {
     for (std::size_t i = start_all; i < out.size(); ++i) {
@@ -158,11 +264,256 @@ inline void build_render_ops(const ViewNode &v, const LayoutNode &l,
   }
 }
 
+} // namespace detail
+
+inline void build_render_ops(const ViewNode &v, const LayoutNode &l,
+                             float parent_opacity, float parent_ox,
+                             float parent_oy, std::vector<RenderOp> &out) {
+  detail::build_render_ops(v, l, parent_opacity, parent_ox, parent_oy, nullptr,
+                           out);
+}
+
 inline std::vector<RenderOp> build_render_ops(const ViewNode &root,
                                               const LayoutNode &layout_root) {
   std::vector<RenderOp> out;
   out.push_back(PushClip{layout_root.frame});
-  build_render_ops(root, layout_root, 1.0f, 0.0f, 0.0f, out);
+  detail::build_render_ops(root, layout_root, 1.0f, 0.0f, 0.0f,
+                           &layout_root.frame, out);
+  out.push_back(PopClip{});
+  return out;
+}
+
+struct RenderOpCache {
+  struct Segment {
+    std::uint64_t identity{};
+    std::size_t records{1};
+    std::size_t begin{};
+    std::size_t end{};
+    RectF frame{};
+    RectF clip{};
+    float opacity{1.0f};
+    float ox{};
+    float oy{};
+    bool reusable{true};
+    bool culled{};
+  };
+
+  std::vector<Segment> segments{};
+  std::unordered_set<std::uint64_t> dirty{};
+  std::size_t emitted_nodes{};
+  std::size_t reused_nodes{};
+  std::size_t culled_nodes{};
+  std::size_t culled_ops{};
+  std::uint64_t next_generation{1};
+
+  void clear() {
+    segments.clear();
+    dirty.clear();
+  }
+
+  void invalidate(const ViewNode &root, const std::vector<std::size_t> &path) {
+    dirty.insert(root.id);
+    const ViewNode *v = &root;
+    for (const auto idx : path) {
+      if (idx >= v->children.size()) {
+        break;
+      }
+      v = &v->children[idx];
+      dirty.insert(v->id);
+    }
+  }
+
+  void invalidate(const std::vector<std::uint64_t> &ids) {
+    dirty.insert(ids.begin(), ids.end());
+  }
+
+  static std::vector<std::uint64_t>
+  path_identities(const ViewNode &root, const std::vector<std::size_t> &path) {
+    std::vector<std::uint64_t> ids;
+    ids.reserve(path.size() + 1);
+    ids.push_back(root.id);
+    const ViewNode *v = &root;
+    for (const auto idx : path) {
+      if (idx >= v->children.size()) {
+        break;
+      }
+      v = &v->children[idx];
+      ids.push_back(v->id);
+    }
+    return ids;
+  }
+};
+
+namespace detail {
+
+struct RenderOpCacheBuild {
+  RenderOpCache &cache;
+  std::vector<RenderOp> &prev;
+  std::vector<RenderOpCache::Segment> prev_segments;
+  std::vector<RenderOp> &out;
+  std::size_t culls{};
+
+  bool emit(const ViewNode &v, const LayoutNode &l, std::uint64_t id,
+            std::size_t prev_idx, float parent_opacity, float parent_ox,
+            float parent_oy, bool scaled, bool transformed, RectF clip_rect) {
+    const bool has_prev = prev_idx < prev_segments.size() &&
+                          prev_segments[prev_idx].identity == id;
+    if (has_prev && !scaled && !cache.dirty.contains(id)) {
+      const auto &seg = prev_segments[prev_idx];
+      if (seg.reusable && seg.end <= prev.size() && same_rect(seg.frame, l.frame) &&
+          (!seg.culled || (!transformed && same_rect(seg.clip, clip_rect))) &&
+          seg.opacity == parent_opacity &&
+          seg.ox == parent_ox && seg.oy == parent_oy) {
+        const auto begin = out.size();
+        out.insert(out.end(),
+                   std::make_move_iterator(prev.begin() +
+                                           static_cast<std::ptrdiff_t>(seg.begin)),
+                   std::make_move_iterator(prev.begin() +
+                                           static_cast<std::ptrdiff_t>(seg.end)));
+        for (std::size_t i = 0; i < seg.records; ++i) {
+          auto s = prev_segments[prev_idx + i];
+          s.begin = s.begin - seg.begin + begin;
+          s.end = s.end - seg.begin + begin;
+          cache.segments.push_back(s);
+        }
+        cache.reused_nodes += seg.records;
+        culls += seg.culled ? 1 : 0;
+        return true;
+      }
+    }
+
+    const bool clip = prop_as_bool(v.props, "clip", false);
+    const bool group = prop_as_bool(v.props, "drawing_group", false);
+    const auto slot = scaled || transformed ? 0 : render_transform_slot(v);
+    const float opacity =
+        parent_opacity * (slot ? 1.0f : prop_as_float(v.props, "opacity", 1.0f));
+    const float ox = parent_ox +
+                     (slot ? 0.0f : prop_as_float(v.props, "render_offset_x", 0.0f));
+    const float oy = parent_oy +
+                     (slot ? 0.0f : prop_as_float(v.props, "render_offset_y", 0.0f));
+    const float render_scale =
+        slot ? 1.0f : prop_as_float(v.props, "render_scale", 1.0f);
+
+    const RectF frame = apply_offset(l.frame, ox, oy);
+    const bool cull = !transformed && !slot && cullable_node(v, render_scale, scaled);
+
+    const auto rec = cache.segments.size();
+    {
+      RenderOpCache::Segment seg;
+      seg.identity = id;
+      seg.begin = out.size();
+      seg.end = out.size();
+      seg.frame = l.frame;
+      seg.clip = clip_rect;
+      seg.opacity = parent_opacity;
+      seg.ox = parent_ox;
+      seg.oy = parent_oy;
+      seg.reusable = !scaled && v.type != "Canvas";
+      cache.segments.push_back(seg);
+    }
+
+    if (cull && clip && outside_clip(frame, clip_rect)) {
+      cache.segments[rec].reusable = true;
+      cache.segments[rec].culled = true;
+      ++cache.culled_nodes;
+      ++culls;
+      return true;
+    }
+    ++cache.emitted_nodes;
+
+    const auto culls_before = culls;
+    const auto start_all = out.size();
+    if (slot) {
+      out.push_back(PushTransform{slot, frame.x, frame.y});
+    }
+    if (group) {
+      out.push_back(PushLayer{frame, id, cache.next_generation++});
+    }
+    if (clip) {
+      out.push_back(PushClip{frame});
+    }
+
+    auto start = out.size();
+    emit_node_ops_pre(v, l, opacity, ox, oy, out);
+    if (cull) {
+      const auto culled = cull_clipped_ops(out, start, clip_rect);
+      cache.culled_ops += culled;
+      culls += culled;
+    }
+
+    const RectF child_clip = clip ? intersect_rect(clip_rect, frame) : clip_rect;
+    bool reusable = cache.segments[rec].reusable;
+    const bool child_scaled = scaled || render_scale != 1.0f;
+    const bool child_transformed = transformed || slot != 0;
+    std::size_t child_prev = has_prev ? prev_idx + 1 : prev_segments.size();
+    const std::size_t prev_end =
+        has_prev ? prev_idx + prev_segments[prev_idx].records : 0;
+    const auto n = std::min(v.children.size(), l.children.size());
+    for (std::size_t i = 0; i < n; ++i) {
+      const auto cid = v.children[i].id;
+      const auto cprev = child_prev < prev_end ? child_prev : prev_segments.size();
+      reusable = emit(v.children[i], l.children[i], cid, cprev, opacity, ox, oy,
+                      child_scaled, child_transformed, child_clip) &&
+                 reusable;
+      if (child_prev < prev_end) {
+        child_prev += prev_segments[child_prev].records;
+      }
+    }
+
+    start = out.size();
+    emit_node_ops_post(v, l, opacity, ox, oy, out);
+    if (cull) {
+      const auto culled = cull_clipped_ops(out, start, clip_rect);
+      cache.culled_ops += culled;
+      culls += culled;
+    }
+
+    if (clip) {
+      out.push_back(PopClip{});
+    }
+    if (group) {
+      out.push_back(PopLayer{});
+    }
+    if (slot) {
+      out.push_back(PopTransform{});
+    }
+
+    if (render_scale != 1.0f) {
+      for (std::size_t i = start_all; i < out.size(); ++i) {
+        apply_scale_about(out[i], frame.x, frame.y, render_scale);
+      }
+    }
+
+    auto &seg = cache.segments[rec];
+    seg.end = out.size();
+    seg.records = cache.segments.size() - rec;
+    seg.reusable = reusable;
+    seg.culled = culls != culls_before;
+    return reusable;
+  }
+};
+
+} // namespace detail
+
+inline std::vector<RenderOp> build_render_ops(const ViewNode &root,
+                                              const LayoutNode &layout_root,
+                                              RenderOpCache &cache,
+                                              std::vector<RenderOp> prev) {
+  std::vector<RenderOp> out;
+  out.reserve(prev.size());
+  out.push_back(PushClip{layout_root.frame});
+
+  cache.emitted_nodes = 0;
+  cache.reused_nodes = 0;
+  cache.culled_nodes = 0;
+  cache.culled_ops = 0;
+  detail::RenderOpCacheBuild build{cache, prev, std::move(cache.segments), out};
+  cache.segments.clear();
+  cache.segments.reserve(build.prev_segments.size());
+  build.emit(root, layout_root, root.id, 0, 1.0f,
+             0.0f, 0.0f, false, false, layout_root.frame);
+  cache.dirty.clear();
+
   out.push_back(PopClip{});
   return out;
 }
@@ -0,0 +1,596 @@
+#pragma once
+
+#include <duorou/ui/render.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace duorou::ui {
+
+enum class RenderCommandKind : std::uint8_t {
+  PushClip,
+  PopClip,
+  Rect,
+  Text,
+  Image,
+  PushLayer,
+  PopLayer,
+  PushTransform,
+  PopTransform,
+};
+
+struct RenderCommand {
+  RenderCommandKind kind{RenderCommandKind::PopClip};
+  std::uint32_t rect{};
+  std::uint32_t color{};
+  std::uint32_t payload{};
+};
+
+struct RenderTextCommand {
+  std::uint64_t hash{};
+  std::uint32_t offset{};
+  std::uint32_t size{};
+  float font_px{16.0f};
+  float align_x{0.5f};
+  float align_y{0.5f};
+  float caret_w{1.0f};
+  float caret_h_factor{1.1f};
+  std::int64_t caret_pos{-1};
+  std::int64_t sel_start{-1};
+  std::int64_t sel_end{-1};
+  bool caret_end{};
+};
+
+struct RenderImageCommand {
+  TextureHandle texture{};
+  RectF uv{0.0f, 0.0f, 1.0f, 1.0f};
+  bool premultiplied{};
+};
+
+struct RenderLayerCommand {
+  std::uint64_t id{};
+  std::uint64_t generation{};
+};
+
+struct RenderCommandBuffer {
+  struct Mark {
+    std::size_t commands{};
+    std::size_t rects{};
+    std::size_t colors{};
+    std::size_t texts{};
+  };
+
+  std::vector<RenderCommand> commands{};
+  std::vector<RectF> rects{};
+  std::vector<ColorU8> colors{};
+  std::vector<RenderTextCommand> texts{};
+  std::vector<RenderImageCommand> images{};
+  std::vector<RenderLayerCommand> layers{};
+  std::string strings{};
+  std::size_t culled_nodes{};
+  std::size_t culled_ops{};
+  std::size_t occluded_ops{};
+
+  void clear() {
+    commands.clear();
+    rects.clear();
+    colors.clear();
+    texts.clear();
+    images.clear();
+    layers.clear();
+    strings.clear();
+    culled_nodes = 0;
+    culled_ops = 0;
+    occluded_ops = 0;
+  }
+
+  std::size_t size() const { return commands.size(); }
+
+  bool empty() const { return commands.empty(); }
+
+  bool has_layers() const { return !layers.empty(); }
+
+  Mark mark() const {
+    return Mark{commands.size(), rects.size(), colors.size(), texts.size()};
+  }
+
+  std::string_view text(const RenderTextCommand &t) const {
+    return std::string_view{strings}.substr(t.offset, t.size);
+  }
+
+  void push_clip(RectF r) {
+    commands.push_back(RenderCommand{RenderCommandKind::PushClip, add_rect(r), 0, 0});
+  }
+
+  void pop_clip() { commands.push_back(RenderCommand{RenderCommandKind::PopClip, 0, 0, 0}); }
+
+  void push_transform(std::uint32_t slot, float origin_x, float origin_y) {
+    commands.push_back(RenderCommand{RenderCommandKind::PushTransform,
+                                     add_rect(RectF{origin_x, origin_y, 0.0f, 0.0f}),
+                                     0, slot});
+  }
+
+  void pop_transform() {
+    commands.push_back(RenderCommand{RenderCommandKind::PopTransform, 0, 0, 0});
+  }
+
+  void push(const RenderOp &op) {
+    if (const auto *c = std::get_if<PushClip>(&op)) {
+      push_clip(c->rect);
+    } else if (std::holds_alternative<PopClip>(op)) {
+      pop_clip();
+    } else if (const auto *r = std::get_if<DrawRect>(&op)) {
+      const auto rect = add_rect(r->rect);
+      const auto color = add_color(r->fill);
+      commands.push_back(RenderCommand{RenderCommandKind::Rect, rect, color, 0});
+    } else if (const auto *t = std::get_if<DrawText>(&op)) {
+      RenderTextCommand tc;
+      tc.hash = t->text_hash ? t->text_hash : text_run_hash(t->text);
+      tc.offset = static_cast<std::uint32_t>(strings.size());
+      tc.size = static_cast<std::uint32_t>(t->text.size());
+      strings.append(t->text);
+      tc.font_px = t->font_px;
+      tc.align_x = t->align_x;
+      tc.align_y = t->align_y;
+      tc.caret_w = t->caret_w;
+      tc.caret_h_factor = t->caret_h_factor;
+      tc.caret_pos = t->caret_pos;
+      tc.sel_start = t->sel_start;
+      tc.sel_end = t->sel_end;
+      tc.caret_end = t->caret_end;
+      const auto rect = add_rect(t->rect);
+      const auto color = add_color(t->color);
+      add_color(t->caret_color);
+      add_color(t->sel_color);
+      commands.push_back(RenderCommand{RenderCommandKind::Text, rect, color,
+                                       static_cast<std::uint32_t>(texts.size())});
+      texts.push_back(tc);
+    } else if (const auto *im = std::get_if<DrawImage>(&op)) {
+      const auto rect = add_rect(im->rect);
+      const auto color = add_color(im->tint);
+      commands.push_back(RenderCommand{RenderCommandKind::Image, rect, color,
+                                       static_cast<std::uint32_t>(images.size())});
+      images.push_back(RenderImageCommand{im->texture, im->uv, im->premultiplied});
+    } else if (const auto *pl = std::get_if<PushLayer>(&op)) {
+      commands.push_back(RenderCommand{RenderCommandKind::PushLayer,
+                                       add_rect(pl->rect), 0,
+                                       static_cast<std::uint32_t>(layers.size())});
+      layers.push_back(RenderLayerCommand{pl->id, pl->generation});
+    } else if (std::holds_alternative<PopLayer>(op)) {
+      commands.push_back(RenderCommand{RenderCommandKind::PopLayer, 0, 0, 0});
+    } else if (const auto *pt = std::get_if<PushTransform>(&op)) {
+      push_transform(pt->slot, pt->origin_x, pt->origin_y);
+    } else if (std::holds_alternative<PopTransform>(op)) {
+      pop_transform();
+    }
+  }
+
+  void assign(const std::vector<RenderOp> &ops) {
+    clear();
+    commands.reserve(ops.size());
+    rects.reserve(ops.size());
+    colors.reserve(ops.size());
+    for (const auto &op : ops) {
+      push(op);
+    }
+  }
+
+  RenderOp op(std::size_t i) const {
+    const auto &c = commands[i];
+    switch (c.kind) {
+    case RenderCommandKind::PushClip:
+      return PushClip{rects[c.rect]};
+    case RenderCommandKind::PopClip:
+      return PopClip{};
+    case RenderCommandKind::Rect:
+      return DrawRect{rects[c.rect], colors[c.color]};
+    case RenderCommandKind::Text: {
+      const auto &tc = texts[c.payload];
+      DrawText t{};
+      t.rect = rects[c.rect];
+      t.text = std::string{text(tc)};
+      t.color = colors[c.color];
+      t.caret_color = colors[c.color + 1];
+      t.sel_color = colors[c.color + 2];
+      t.font_px = tc.font_px;
+      t.align_x = tc.align_x;
+      t.align_y = tc.align_y;
+      t.caret_end = tc.caret_end;
+      t.caret_pos = tc.caret_pos;
+      t.caret_w = tc.caret_w;
+      t.caret_h_factor = tc.caret_h_factor;
+      t.sel_start = tc.sel_start;
+      t.sel_end = tc.sel_end;
+      t.text_hash = tc.hash;
+      return t;
+    }
+    case RenderCommandKind::Image: {
+      const auto &ic = images[c.payload];
+      DrawImage im{};
+      im.rect = rects[c.rect];
+      im.texture = ic.texture;
+      im.uv = ic.uv;
+      im.tint = colors[c.color];
+      im.premultiplied = ic.premultiplied;
+      return im;
+    }
+    case RenderCommandKind::PushLayer:
+      return PushLayer{rects[c.rect], layers[c.payload].id,
+                       layers[c.payload].generation};
+    case RenderCommandKind::PopLayer:
+      return PopLayer{};
+    case RenderCommandKind::PushTransform:
+      return PushTransform{c.payload, rects[c.rect].x, rects[c.rect].y};
+    case RenderCommandKind::PopTransform:
+      return PopTransform{};
+    }
+    return PopClip{};
+  }
+
+  std::vector<RenderOp> to_ops() const {
+    std::vector<RenderOp> out;
+    out.reserve(commands.size());
+    for (std::size_t i = 0; i < commands.size(); ++i) {
+      out.push_back(op(i));
+    }
+    return out;
+  }
+
+  void translate(Mark from, Mark to, float dx, float dy) {
+    if (dx == 0.0f && dy == 0.0f) {
+      return;
+    }
+    auto *r = rects.data();
+    for (std::size_t i = from.rects; i < to.rects; ++i) {
+      r[i].x += dx;
+      r[i].y += dy;
+    }
+  }
+
+  void fade(Mark from, Mark to, float opacity) {
+    if (opacity >= 1.0f || from.colors == to.colors) {
+      return;
+    }
+    auto *c = colors.data();
+    if (to.colors - from.colors < 64) {
+      for (std::size_t i = from.colors; i < to.colors; ++i) {
+        c[i].a = apply_opacity_u8(c[i].a, opacity);
+      }
+      return;
+    }
+    std::uint8_t lut[256];
+    for (int a = 0; a < 256; ++a) {
+      lut[a] = apply_opacity_u8(static_cast<std::uint8_t>(a), opacity);
+    }
+    for (std::size_t i = from.colors; i < to.colors; ++i) {
+      c[i].a = lut[c[i].a];
+    }
+  }
+
+  void scale_about(Mark from, Mark to, float ox, float oy, float s) {
+    if (s == 1.0f) {
+      return;
+    }
+    auto *r = rects.data();
+    for (std::size_t i = from.rects; i < to.rects; ++i) {
+      r[i].x = ox + (r[i].x - ox) * s;
+      r[i].y = oy + (r[i].y - oy) * s;
+      r[i].w *= s;
+      r[i].h *= s;
+    }
+    for (std::size_t i = from.texts; i < to.texts; ++i) {
+      texts[i].font_px *= s;
+      texts[i].caret_w *= s;
+    }
+  }
+
+  std::size_t cull_occluded(std::size_t max_occluders = 8) {
+    const auto n = commands.size();
+    std::vector<RectF> visible(n);
+    std::vector<bool> layered(n, false);
+    {
+      std::vector<RectF> clip_stack;
+      std::size_t layer_depth = 0;
+      for (std::size_t i = 0; i < n; ++i) {
+        const auto &c = commands[i];
+        switch (c.kind) {
+        case RenderCommandKind::PushClip:
+          clip_stack.push_back(clip_stack.empty()
+                                   ? rects[c.rect]
+                                   : intersect_rect(clip_stack.back(), rects[c.rect]));
+          break;
+        case RenderCommandKind::PopClip:
+          if (!clip_stack.empty()) {
+            clip_stack.pop_back();
+          }
+          break;
+        case RenderCommandKind::PushLayer:
+        case RenderCommandKind::PushTransform:
+          ++layer_depth;
+          break;
+        case RenderCommandKind::PopLayer:
+        case RenderCommandKind::PopTransform:
+          layer_depth = layer_depth > 0 ? layer_depth - 1 : 0;
+          break;
+        default:
+          visible[i] = clip_stack.empty()
+                           ? rects[c.rect]
+                           : intersect_rect(clip_stack.back(), rects[c.rect]);
+          layered[i] = layer_depth > 0;
+          break;
+        }
+      }
+    }
+
+    auto contains = [](RectF outer, RectF r) {
+      return r.x >= outer.x && r.y >= outer.y && r.x + r.w <= outer.x + outer.w &&
+             r.y + r.h <= outer.y + outer.h;
+    };
+    std::vector<RectF> occluders;
+    occluders.reserve(max_occluders);
+    std::vector<bool> hidden(n, false);
+    std::size_t count = 0;
+    for (std::size_t i = n; i-- > 0;) {
+      const auto &c = commands[i];
+      if (layered[i] || (c.kind != RenderCommandKind::Rect &&
+                         c.kind != RenderCommandKind::Text &&
+                         c.kind != RenderCommandKind::Image)) {
+        continue;
+      }
+      const auto r = visible[i];
+      if (!(r.w > 0.0f) || !(r.h > 0.0f)) {
+        continue;
+      }
+      if (std::any_of(occluders.begin(), occluders.end(),
+                      [&](RectF o) { return contains(o, r); })) {
+        hidden[i] = true;
+        ++count;
+        continue;
+      }
+      if (c.kind != RenderCommandKind::Rect || colors[c.color].a != 255 ||
+          max_occluders == 0) {
+        continue;
+      }
+      if (occluders.size() < max_occluders) {
+        occluders.push_back(r);
+        continue;
+      }
+      auto smallest = std::min_element(
+          occluders.begin(), occluders.end(),
+          [](RectF a, RectF b) { return a.w * a.h < b.w * b.h; });
+      if (smallest->w * smallest->h < r.w * r.h) {
+        *smallest = r;
+      }
+    }
+
+    if (count > 0) {
+      std::size_t w = 0;
+      for (std::size_t i = 0; i < n; ++i) {
+        if (!hidden[i]) {
+          commands[w++] = commands[i];
+        }
+      }
+      commands.resize(w);
+    }
+    occluded_ops += count;
+    return count;
+  }
+
+private:
+  std::uint32_t add_rect(RectF r) {
+    rects.push_back(r);
+    return static_cast<std::uint32_t>(rects.size() - 1);
+  }
+
+  std::uint32_t add_color(ColorU8 c) {
+    colors.push_back(c);
+    return static_cast<std::uint32_t>(colors.size() - 1);
+  }
+};
+
+namespace detail {
+
+struct RenderTextRun {
+  RectF rect;
+  ColorU8 color;
+  ColorU8 caret_color;
+  ColorU8 sel_color;
+  float font_px{};
+  float align_x{};
+  float align_y{};
+  bool caret_end{};
+  std::int64_t caret_pos{-1};
+  float caret_w{};
+  float caret_h_factor{};
+  std::int64_t sel_start{-1};
+  std::int64_t sel_end{-1};
+  std::uint64_t text_hash{};
+};
+
+struct RenderCommandSource {
+  const RenderCommandBuffer &buf;
+
+  std::size_t size() const { return buf.commands.size(); }
+
+  void clip(std::size_t i, std::vector<RectF> &stack, SizeF viewport) const {
+    const auto &c = buf.commands[i];
+    if (c.kind == RenderCommandKind::PushClip) {
+      stack.push_back(intersect_rect(stack.back(), buf.rects[c.rect]));
+    } else if (c.kind == RenderCommandKind::PopClip) {
+      stack.pop_back();
+      if (stack.empty()) {
+        stack.push_back(RectF{0.0f, 0.0f, viewport.w, viewport.h});
+      }
+    }
+  }
+
+  void transform(std::size_t i, RenderTransformTracker &t,
+                 std::vector<RectF> &stack, SizeF viewport) const {
+    const auto &c = buf.commands[i];
+    if (c.kind == RenderCommandKind::PushTransform) {
+      t.push(c.payload, buf.rects[c.rect].x, buf.rects[c.rect].y, stack);
+    } else if (c.kind == RenderCommandKind::PopTransform) {
+      t.pop(stack, viewport);
+    }
+  }
+
+  std::string_view text(std::size_t i, float &font_px,
+                        std::uint64_t &hash) const {
+    const auto &c = buf.commands[i];
+    if (c.kind != RenderCommandKind::Text) {
+      return {};
+    }
+    font_px = buf.texts[c.payload].font_px;
+    hash = buf.texts[c.payload].hash;
+    return buf.text(buf.texts[c.payload]);
+  }
+
+  void emit(std::size_t i, RenderTreeWriter &w, RectF sc, TextProvider *text,
+            const TextLayout *pre) const {
+    const auto &c = buf.commands[i];
+    switch (c.kind) {
+    case RenderCommandKind::Rect:
+      w.rect(buf.rects[c.rect], buf.colors[c.color], sc);
+      break;
+    case RenderCommandKind::Image: {
+      const auto &ic = buf.images[c.payload];
+      w.image(buf.rects[c.rect], ic.texture, ic.uv, buf.colors[c.color],
+              ic.premultiplied, sc);
+      break;
+    }
+    case RenderCommandKind::Text: {
+      const auto &tc = buf.texts[c.payload];
+      RenderTextRun run;
+      run.rect = buf.rects[c.rect];
+      run.color = buf.colors[c.color];
+      run.caret_color = buf.colors[c.color + 1];
+      run.sel_color = buf.colors[c.color + 2];
+      run.font_px = tc.font_px;
+      run.align_x = tc.align_x;
+      run.align_y = tc.align_y;
+      run.caret_end = tc.caret_end;
+      run.caret_pos = tc.caret_pos;
+      run.caret_w = tc.caret_w;
+      run.caret_h_factor = tc.caret_h_factor;
+      run.sel_start = tc.sel_start;
+      run.sel_end = tc.sel_end;
+      run.text_hash = tc.hash;
+      w.emit_text(run, buf.text(tc), sc, text, pre);
+      break;
+    }
+    default:
+      break;
+    }
+  }
+};
+
+struct RenderCommandBuild {
+  RenderCommandBuffer &out;
+  std::vector<RenderOp> scratch{};
+
+  void append(float opacity, float ox, float oy) {
+    const auto from = out.mark();
+    for (const auto &op : scratch) {
+      out.push(op);
+    }
+    scratch.clear();
+    const auto to = out.mark();
+    out.fade(from, to, opacity);
+    out.translate(from, to, ox, oy);
+  }
+
+  void node(const ViewNode &v, const LayoutNode &l, float parent_opacity,
+            float parent_ox, float parent_oy, bool scaled, bool transformed,
+            RectF clip_rect) {
+    const bool clip = prop_as_bool(v.props, "clip", false);
+    const auto slot = scaled || transformed ? 0 : render_transform_slot(v);
+    const float opacity =
+        parent_opacity * (slot ? 1.0f : prop_as_float(v.props, "opacity", 1.0f));
+    const float ox = parent_ox +
+                     (slot ? 0.0f : prop_as_float(v.props, "render_offset_x", 0.0f));
+    const float oy = parent_oy +
+                     (slot ? 0.0f : prop_as_float(v.props, "render_offset_y", 0.0f));
+    const float render_scale =
+        slot ? 1.0f : prop_as_float(v.props, "render_scale", 1.0f);
+
+    const RectF frame = apply_offset(l.frame, ox, oy);
+    const bool cull = !transformed && !slot && cullable_node(v, render_scale, scaled);
+    if (cull && clip && outside_clip(frame, clip_rect)) {
+      ++out.culled_nodes;
+      return;
+    }
+
+    const auto start = out.mark();
+    if (slot) {
+      out.push_transform(slot, frame.x, frame.y);
+    }
+    if (clip) {
+      out.push_clip(frame);
+    }
+
+    const RectF local_clip = apply_offset(clip_rect, -ox, -oy);
+    emit_node_content_ops(v, l, scratch);
+    if (cull) {
+      out.culled_ops += cull_clipped_ops(scratch, 0, local_clip);
+    }
+    append(opacity, ox, oy);
+
+    const bool child_scaled = scaled || render_scale != 1.0f;
+    const bool child_transformed = transformed || slot != 0;
+    const RectF child_clip = clip ? intersect_rect(clip_rect, frame) : clip_rect;
+    const auto n = std::min(v.children.size(), l.children.size());
+    for (std::size_t i = 0; i < n; ++i) {
+      node(v.children[i], l.children[i], opacity, ox, oy, child_scaled,
+           child_transformed, child_clip);
+    }
+
+    emit_node_overlay_ops(v, l, scratch);
+    if (cull) {
+      out.culled_ops += cull_clipped_ops(scratch, 0, local_clip);
+    }
+    append(opacity, ox, oy);
+
+    if (clip) {
+      out.pop_clip();
+    }
+    if (slot) {
+      out.pop_transform();
+    }
+
+    out.scale_about(start, out.mark(), frame.x, frame.y, render_scale);
+  }
+};
+
+} // namespace detail
+
+inline void build_render_commands(const ViewNode &root,
+                                  const LayoutNode &layout_root,
+                                  RenderCommandBuffer &out) {
+  out.clear();
+  out.push_clip(layout_root.frame);
+  detail::RenderCommandBuild build{out};
+  build.node(root, layout_root, 1.0f, 0.0f, 0.0f, false, false,
+             layout_root.frame);
+  out.pop_clip();
+}
+
+inline RenderTree build_render_tree(const RenderCommandBuffer &commands,
+                                    SizeF viewport, TextProvider &text) {
+  return detail::build_render_tree_serial(
+      detail::RenderCommandSource{commands}, viewport, text);
+}
+
+inline RenderTree build_render_tree(const RenderCommandBuffer &commands,
+                                    SizeF viewport, TextProvider &text,
+                                    ThreadPool &pool,
+                                    std::size_t min_chunk_ops = 512) {
+  return detail::build_render_tree_parallel(
+      detail::RenderCommandSource{commands}, viewport, text, pool,
+      min_chunk_ops);
+}
+
+} // namespace duorou::ui
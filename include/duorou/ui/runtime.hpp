@@ -2,21 +2,32 @@
 
 #include <duorou/ui/node.hpp>
 
+#include <duorou/ui/animation.hpp>
+
+#include <duorou/ui/event_handler.hpp>
+#include <duorou/ui/ui_queue.hpp>
+
 #include <duorou/ui/layout.hpp>
 
 #include <duorou/ui/render.hpp>
 
 #include <duorou/ui/style_parser.hpp>
 
+#include <duorou/ui/thread_pool.hpp>
+
 #include <algorithm>
 #include <atomic>
+#include <bit>
+#include <cassert>
 #include <chrono>
 #include <cmath>
 #include <cstdint>
+#include <cstdio>
 #include <cstdlib>
 #include <filesystem>
 #include <fstream>
 #include <functional>
+#include <iterator>
 #include <limits>
 #include <memory>
 #include <mutex>
@@ -65,6 +76,61 @@ struct AnimationSpec {
   std::string curve{"easeInOut"};
 };
 
+namespace detail {
+
+struct SubscriberNode {
+  enum Status : std::uint32_t { Free, Claimed, Active, Retired, Orphaned };
+
+  std::function<void()> cb{};
+  const void *owner{};
+  std::atomic<std::uint32_t> status{Free};
+  std::atomic<std::uint32_t> readers{0};
+  std::atomic<std::uint32_t> holders{1};
+  SubscriberNode *next{};
+
+  bool try_claim() {
+    auto s = status.load();
+    if (s == Free) {
+      return status.compare_exchange_strong(s, Claimed);
+    }
+    if (s == Retired && readers.load() == 0 &&
+        status.compare_exchange_strong(s, Claimed)) {
+      cb = nullptr;
+      owner = nullptr;
+      return true;
+    }
+    return false;
+  }
+
+  void retire() {
+    status.store(Retired);
+    if (try_claim()) {
+      status.store(Free, std::memory_order_release);
+    }
+  }
+
+  void release() {
+    if (holders.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+};
+
+struct PendingState {
+  StateBase *state{};
+  std::shared_ptr<StateBase> hold{};
+};
+
+struct PendingNotifications {
+  int depth{};
+  std::vector<PendingState> states;
+  std::vector<const void *> owners;
+};
+
+inline thread_local PendingNotifications pending_notifications;
+
+} // namespace detail
+
 class Subscription {
 public:
   Subscription() = default;
@@ -72,80 +138,169 @@ public:
   Subscription &operator=(const Subscription &) = delete;
 
   Subscription(Subscription &&other) noexcept
-      : state_{std::exchange(other.state_, nullptr)},
-        id_{std::exchange(other.id_, 0)} {}
+      : node_{std::exchange(other.node_, nullptr)} {}
 
   Subscription &operator=(Subscription &&other) noexcept {
     if (this == &other) {
       return *this;
     }
     reset();
-    state_ = std::exchange(other.state_, nullptr);
-    id_ = std::exchange(other.id_, 0);
+    node_ = std::exchange(other.node_, nullptr);
     return *this;
   }
 
   ~Subscription() { reset(); }
 
-  void reset();
+  bool active() const {
+    return node_ && node_->status.load(std::memory_order_acquire) ==
+                        detail::SubscriberNode::Active;
+  }
+
+  void reset() {
+    if (auto *n = std::exchange(node_, nullptr)) {
+      n->retire();
+      n->release();
+    }
+  }
 
 private:
   friend class StateBase;
-  explicit Subscription(StateBase *state, std::uint64_t id)
-      : state_{state}, id_{id} {}
+  explicit Subscription(detail::SubscriberNode *node) : node_{node} {}
 
-  StateBase *state_{};
-  std::uint64_t id_{};
+  detail::SubscriberNode *node_{};
 };
 
-class StateBase {
+class StateBase : public std::enable_shared_from_this<StateBase> {
 public:
-  virtual ~StateBase() = default;
   using Callback = std::function<void()>;
 
-  std::uint64_t version() const noexcept {
-    return version_.load(std::memory_order_relaxed);
+  StateBase() = default;
+  StateBase(const StateBase &) = delete;
+  StateBase &operator=(const StateBase &) = delete;
+
+  virtual ~StateBase() {
+    if (pending_.load(std::memory_order_relaxed)) {
+      auto &v = detail::pending_notifications.states;
+      v.erase(std::remove_if(v.begin(), v.end(),
+                             [this](const detail::PendingState &p) {
+                               return p.state == this;
+                             }),
+              v.end());
+    }
+    auto *n = head_.load(std::memory_order_acquire);
+    while (n) {
+      auto *next = n->next;
+      n->status.store(detail::SubscriberNode::Orphaned);
+      n->release();
+      n = next;
+    }
   }
 
-  Subscription subscribe(Callback cb) {
-    std::lock_guard<std::mutex> lock{mutex_};
-    const auto id = ++next_id_;
-    callbacks_.emplace(id, std::move(cb));
-    return Subscription{this, id};
+  std::uint64_t version() const noexcept {
+    return version_.load(std::memory_order_relaxed);
   }
 
-private:
-  friend class Subscription;
-  void unsubscribe(std::uint64_t id) {
-    std::lock_guard<std::mutex> lock{mutex_};
-    callbacks_.erase(id);
+  Subscription subscribe(Callback cb, const void *owner = nullptr) {
+    auto *node = claim_node();
+    node->holders.fetch_add(1, std::memory_order_relaxed);
+    node->cb = std::move(cb);
+    node->owner = owner;
+    node->status.store(detail::SubscriberNode::Active,
+                       std::memory_order_release);
+    return Subscription{node};
+  }
+
+  static void flush_notifications() {
+    auto &pending = detail::pending_notifications;
+    while (!pending.states.empty()) {
+      std::vector<detail::PendingState> states;
+      states.swap(pending.states);
+      pending.owners.clear();
+      for (auto &p : states) {
+        p.state->pending_.store(false, std::memory_order_relaxed);
+      }
+      for (auto &p : states) {
+        p.state->for_each_subscriber([&](detail::SubscriberNode &n) {
+          if (n.owner) {
+            auto &owners = pending.owners;
+            if (std::find(owners.begin(), owners.end(), n.owner) !=
+                owners.end()) {
+              return;
+            }
+            owners.push_back(n.owner);
+          }
+          n.cb();
+        });
+      }
+    }
   }
 
 protected:
   void notify_changed() {
     version_.fetch_add(1, std::memory_order_relaxed);
-    std::vector<Callback> callbacks;
-    {
-      std::lock_guard<std::mutex> lock{mutex_};
-      callbacks.reserve(callbacks_.size());
-      for (auto &kv : callbacks_) {
-        callbacks.push_back(kv.second);
+    if (detail::pending_notifications.depth > 0) {
+      if (!pending_.exchange(true, std::memory_order_relaxed)) {
+        detail::pending_notifications.states.push_back(
+            detail::PendingState{this, weak_from_this().lock()});
       }
+      return;
     }
-    for (auto &cb : callbacks) {
-      if (cb) {
-        cb();
+    for_each_subscriber([](detail::SubscriberNode &n) { n.cb(); });
+  }
+
+private:
+  detail::SubscriberNode *claim_node() {
+    for (auto *n = head_.load(std::memory_order_acquire); n; n = n->next) {
+      if (n->try_claim()) {
+        return n;
       }
     }
+    auto *n = new detail::SubscriberNode{};
+    n->status.store(detail::SubscriberNode::Claimed, std::memory_order_relaxed);
+    n->next = head_.load(std::memory_order_relaxed);
+    while (!head_.compare_exchange_weak(n->next, n, std::memory_order_release,
+                                        std::memory_order_relaxed)) {
+    }
+    return n;
+  }
+
+  template <typename F> void for_each_subscriber(F &&f) {
+    for (auto *n = head_.load(std::memory_order_acquire); n; n = n->next) {
+      if (n->status.load(std::memory_order_relaxed) !=
+          detail::SubscriberNode::Active) {
+        continue;
+      }
+      n->readers.fetch_add(1);
+      if (n->status.load() == detail::SubscriberNode::Active && n->cb) {
+        f(*n);
+      }
+      n->readers.fetch_sub(1, std::memory_order_release);
+    }
   }
 
-private:
   std::atomic<std::uint64_t> version_{0};
-  std::mutex mutex_{};
-  std::uint64_t next_id_{0};
-  std::unordered_map<std::uint64_t, Callback> callbacks_{};
+  std::atomic<detail::SubscriberNode *> head_{nullptr};
+  std::atomic<bool> pending_{false};
+};
+
+class StateTransaction {
+public:
+  StateTransaction() { ++detail::pending_notifications.depth; }
+  StateTransaction(const StateTransaction &) = delete;
+  StateTransaction &operator=(const StateTransaction &) = delete;
+
+  ~StateTransaction() {
+    if (--detail::pending_notifications.depth == 0) {
+      StateBase::flush_notifications();
+    }
+  }
 };
 
+template <typename F> decltype(auto) transaction(F &&fn) {
+  StateTransaction tx;
+  return std::forward<F>(fn)();
+}
+
 class ObservableObject : public StateBase {
 public:
   void notify() { notify_changed(); }
@@ -775,25 +930,21 @@ public:
 
 
 
-inline void Subscription::reset() {
-  if (!state_ || id_ == 0) {
-    return;
-  }
-  state_->unsubscribe(id_);
-  state_ = nullptr;
-  id_ = 0;
-}
-
 namespace detail {
 
 struct DependencyCollector {
-  std::unordered_set<StateBase *> states;
+  std::vector<StateBase *> states;
 
   void add(StateBase *s) {
-    if (!s) {
+    if (!s || (!states.empty() && states.back() == s)) {
       return;
     }
-    states.insert(s);
+    states.push_back(s);
+  }
+
+  void finish() {
+    std::sort(states.begin(), states.end());
+    states.erase(std::unique(states.begin(), states.end()), states.end());
   }
 };
 
@@ -806,12 +957,42 @@ inline void record_dependency(StateBase *state) {
 }
 
 struct EventCollector {
-  std::uint64_t next_id{0};
-  std::unordered_map<std::uint64_t, std::function<void()>> handlers;
+  struct Stable {
+    std::uint64_t signature{};
+    std::uint64_t slot{};
+  };
 
-  std::uint64_t add(std::function<void()> fn) {
-    const auto id = ++next_id;
-    handlers.emplace(id, std::move(fn));
+  std::vector<EventHandler> handlers;
+  std::vector<EventHandler> *previous{};
+  const std::unordered_map<std::uint64_t, Stable> *previous_stable{};
+  std::unordered_map<std::uint64_t, Stable> stable;
+  std::size_t reused{};
+
+  template <typename F> std::uint64_t add(F &&fn) {
+    handlers.emplace_back(std::forward<F>(fn));
+    return handlers.size();
+  }
+
+  template <typename F>
+  std::uint64_t add_stable(NodeId node, EventKind kind, std::uint64_t signature,
+                           F &&fn) {
+    const auto key =
+        stable_node_id(node, {}, static_cast<std::size_t>(kind), {});
+    if (previous && previous_stable) {
+      const auto it = previous_stable->find(key);
+      if (it != previous_stable->end() && it->second.signature == signature &&
+          it->second.slot != 0 && it->second.slot <= previous->size()) {
+        auto &old = (*previous)[it->second.slot - 1];
+        if (old) {
+          handlers.push_back(std::move(old));
+          stable.insert_or_assign(key, Stable{signature, handlers.size()});
+          ++reused;
+          return handlers.size();
+        }
+      }
+    }
+    const auto id = add(std::forward<F>(fn));
+    stable.insert_or_assign(key, Stable{signature, id});
     return id;
   }
 };
@@ -826,6 +1007,8 @@ struct EventDispatchContext {
   int scancode{};
   int action{};
   int mods{};
+  float velocity_x{};
+  float velocity_y{};
   std::string text;
   ViewInstance *instance{};
   std::vector<std::size_t> target_path;
@@ -840,43 +1023,43 @@ void request_animation(const AnimationSpec &spec);
 
 } // namespace detail
 
-inline std::uint64_t on_click(std::function<void()> fn) {
+template <typename F> inline std::uint64_t on_click(F &&fn) {
   if (!detail::active_event_collector) {
     return 0;
   }
-  return detail::active_event_collector->add(std::move(fn));
+  return detail::active_event_collector->add(std::forward<F>(fn));
 }
 
-inline std::uint64_t on_pointer_down(std::function<void()> fn) {
-  return on_click(std::move(fn));
+template <typename F> inline std::uint64_t on_pointer_down(F &&fn) {
+  return on_click(std::forward<F>(fn));
 }
 
-inline std::uint64_t on_pointer_up(std::function<void()> fn) {
-  return on_click(std::move(fn));
+template <typename F> inline std::uint64_t on_pointer_up(F &&fn) {
+  return on_click(std::forward<F>(fn));
 }
 
-inline std::uint64_t on_pointer_move(std::function<void()> fn) {
-  return on_click(std::move(fn));
+template <typename F> inline std::uint64_t on_pointer_move(F &&fn) {
+  return on_click(std::forward<F>(fn));
 }
 
-inline std::uint64_t on_focus(std::function<void()> fn) {
-  return on_click(std::move(fn));
+template <typename F> inline std::uint64_t on_focus(F &&fn) {
+  return on_click(std::forward<F>(fn));
 }
 
-inline std::uint64_t on_blur(std::function<void()> fn) {
-  return on_click(std::move(fn));
+template <typename F> inline std::uint64_t on_blur(F &&fn) {
+  return on_click(std::forward<F>(fn));
 }
 
-inline std::uint64_t on_key_down(std::function<void()> fn) {
-  return on_click(std::move(fn));
+template <typename F> inline std::uint64_t on_key_down(F &&fn) {
+  return on_click(std::forward<F>(fn));
 }
 
-inline std::uint64_t on_key_up(std::function<void()> fn) {
-  return on_click(std::move(fn));
+template <typename F> inline std::uint64_t on_key_up(F &&fn) {
+  return on_click(std::forward<F>(fn));
 }
 
-inline std::uint64_t on_text_input(std::function<void()> fn) {
-  return on_click(std::move(fn));
+template <typename F> inline std::uint64_t on_text_input(F &&fn) {
+  return on_click(std::forward<F>(fn));
 }
 
 inline int pointer_id() {
@@ -895,6 +1078,18 @@ inline float pointer_y() {
                                          : 0.0f;
 }
 
+inline float pointer_velocity_x() {
+  return detail::active_dispatch_context
+             ? detail::active_dispatch_context->velocity_x
+             : 0.0f;
+}
+
+inline float pointer_velocity_y() {
+  return detail::active_dispatch_context
+             ? detail::active_dispatch_context->velocity_y
+             : 0.0f;
+}
+
 inline int key_code() {
   return detail::active_dispatch_context ? detail::active_dispatch_context->key
                                          : 0;
@@ -940,7 +1135,8 @@ void capture_pointer();
 
 void release_pointer();
 
-template <typename T> class State final : public StateBase {
+template <typename T>
+class State final : public StateBase {
 public:
   explicit State(T initial) : value_{std::move(initial)} {}
 
@@ -961,9 +1157,43 @@ public:
     notify_changed();
   }
 
+  void set_async(T v) {
+    auto weak = weak_from_this();
+    assert(!weak.expired() && "set_async requires a shared_ptr-owned State");
+    if (weak.expired()) {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock{value_mutex_};
+      async_value_ = std::move(v);
+    }
+    if (async_posted_.exchange(true, std::memory_order_acq_rel)) {
+      return;
+    }
+    post_to_ui([weak = std::move(weak)]() {
+      if (auto self = weak.lock()) {
+        static_cast<State *>(self.get())->apply_async();
+      }
+    });
+  }
+
 private:
+  void apply_async() {
+    async_posted_.store(false, std::memory_order_release);
+    std::optional<T> v;
+    {
+      std::lock_guard<std::mutex> lock{value_mutex_};
+      v.swap(async_value_);
+    }
+    if (v) {
+      set(std::move(*v));
+    }
+  }
+
   mutable std::mutex value_mutex_{};
   T value_{};
+  std::optional<T> async_value_{};
+  std::atomic<bool> async_posted_{false};
 };
 
 template <typename T> class StateHandle {
@@ -974,6 +1204,8 @@ public:
 
   void set(T v) { ptr_->set(std::move(v)); }
 
+  void set_async(T v) { ptr_->set_async(std::move(v)); }
+
   StateBase *base() const { return ptr_.get(); }
 
 private:
@@ -1156,8 +1388,13 @@ struct PatchRemoveChild {
   std::size_t index{};
 };
 
+struct PatchSetKey {
+  std::vector<std::size_t> path;
+  std::string key;
+};
+
 using PatchOp = std::variant<PatchSetProp, PatchRemoveProp, PatchReplaceNode,
-                             PatchInsertChild, PatchRemoveChild>;
+                             PatchInsertChild, PatchRemoveChild, PatchSetKey>;
 
 inline void dump_path(std::ostream &os, const std::vector<std::size_t> &path) {
   os << "[";
@@ -1198,6 +1435,10 @@ inline void dump_patches(std::ostream &os,
             os << "RemoveChild ";
             dump_path(os, op.parent_path);
             os << " @" << op.index << "\n";
+          } else if constexpr (std::is_same_v<T, PatchSetKey>) {
+            os << "SetKey ";
+            dump_path(os, op.path);
+            os << " " << op.key << "\n";
           }
         },
         p);
@@ -1212,6 +1453,10 @@ inline void diff_nodes(const ViewNode &old_node, const ViewNode &new_node,
     return;
   }
 
+  if (old_node.key != new_node.key) {
+    out.push_back(PatchSetKey{path, new_node.key});
+  }
+
   for (const auto &kv : new_node.props) {
     const auto it = old_node.props.find(kv.first);
     if (it == old_node.props.end() || it->second != kv.second) {
@@ -1254,6 +1499,148 @@ inline std::vector<PatchOp> diff_tree(const ViewNode &old_root,
   return out;
 }
 
+class NodeKeyIndex {
+public:
+  void clear() {
+    paths_.clear();
+    duplicates_.clear();
+  }
+
+  void rebuild(const ViewNode &root) {
+    clear();
+    std::vector<std::size_t> path;
+    add_subtree(root, path);
+  }
+
+  void apply(const ViewNode &root, const std::vector<PatchOp> &patches) {
+    struct Range {
+      std::vector<std::size_t> parent;
+      std::size_t first{};
+      std::size_t last{};
+    };
+    std::vector<Range> erased;
+    std::vector<std::vector<std::size_t>> added;
+    bool full = false;
+    auto touch = [&](const std::vector<std::size_t> &path) {
+      if (path.empty()) {
+        full = true;
+        return;
+      }
+      Range r{path, path.back(), path.back() + 1};
+      r.parent.pop_back();
+      erased.push_back(std::move(r));
+      added.push_back(path);
+    };
+    for (const auto &p : patches) {
+      std::visit(
+          [&](const auto &op) {
+            using T = std::decay_t<decltype(op)>;
+            if constexpr (std::is_same_v<T, PatchReplaceNode> ||
+                          std::is_same_v<T, PatchSetKey>) {
+              touch(op.path);
+            } else if constexpr (std::is_same_v<T, PatchInsertChild>) {
+              auto path = op.parent_path;
+              path.push_back(op.index);
+              touch(path);
+            } else if constexpr (std::is_same_v<T, PatchRemoveChild>) {
+              if (erased.empty() || erased.back().parent != op.parent_path ||
+                  erased.back().first != op.index) {
+                erased.push_back(
+                    Range{op.parent_path, op.index, static_cast<std::size_t>(-1)});
+              }
+            }
+          },
+          p);
+      if (full) {
+        break;
+      }
+    }
+    if (full || erased.size() > kMaxIncrementalRanges) {
+      rebuild(root);
+      return;
+    }
+    if (!erased.empty()) {
+      auto covered = [&](const std::vector<std::size_t> &path) {
+        for (const auto &r : erased) {
+          if (path.size() > r.parent.size() &&
+              std::equal(r.parent.begin(), r.parent.end(), path.begin()) &&
+              path[r.parent.size()] >= r.first &&
+              path[r.parent.size()] < r.last) {
+            return true;
+          }
+        }
+        return false;
+      };
+      for (auto it = paths_.begin(); it != paths_.end();) {
+        auto &v = it->second;
+        v.erase(std::remove_if(v.begin(), v.end(), covered), v.end());
+        if (v.size() < 2) {
+          duplicates_.erase(it->first);
+        }
+        it = v.empty() ? paths_.erase(it) : std::next(it);
+      }
+    }
+    for (auto &path : added) {
+      const ViewNode *v = &root;
+      for (const auto idx : path) {
+        v = idx < v->children.size() ? &v->children[idx] : nullptr;
+        if (!v) {
+          break;
+        }
+      }
+      if (v) {
+        add_subtree(*v, path);
+      }
+    }
+  }
+
+  const std::vector<std::size_t> *find(const std::string &key) const {
+    if (key.empty()) {
+      return nullptr;
+    }
+    const auto it = paths_.find(key);
+    if (it == paths_.end() || it->second.empty()) {
+      return nullptr;
+    }
+    return &*std::min_element(it->second.begin(), it->second.end());
+  }
+
+  std::vector<std::string> duplicates() const {
+    std::vector<std::string> out{duplicates_.begin(), duplicates_.end()};
+    std::sort(out.begin(), out.end());
+    return out;
+  }
+
+  std::size_t duplicate_count() const { return duplicates_.size(); }
+
+  bool is_duplicate(const std::string &key) const {
+    return duplicates_.contains(key);
+  }
+
+private:
+  static constexpr std::size_t kMaxIncrementalRanges = 64;
+
+  void add_subtree(const ViewNode &v, std::vector<std::size_t> &path) {
+    if (!v.key.empty()) {
+      auto &paths = paths_[v.key];
+      if (std::find(paths.begin(), paths.end(), path) == paths.end()) {
+        paths.push_back(path);
+      }
+      if (paths.size() > 1) {
+        duplicates_.insert(v.key);
+      }
+    }
+    for (std::size_t i = 0; i < v.children.size(); ++i) {
+      path.push_back(i);
+      add_subtree(v.children[i], path);
+      path.pop_back();
+    }
+  }
+
+  std::unordered_map<std::string, std::vector<std::vector<std::size_t>>> paths_;
+  std::unordered_set<std::string> duplicates_;
+};
+
 class StyleManager : public ObservableObject {
 public:
   void clear() {
@@ -1761,82 +2148,344 @@ private:
   std::unordered_map<std::string, BaseCacheEntry> base_cache_{};
 };
 
-class ViewInstance {
+class CancelToken;
+
+namespace detail {
+template <typename F, typename Token>
+decltype(auto) invoke_task(F &fn, const Token &cancel) {
+  if constexpr (std::is_invocable_v<F &, const Token &>) {
+    return fn(cancel);
+  } else {
+    return fn();
+  }
+}
+} // namespace detail
+
+class CancelToken {
 public:
-  using ViewFn = std::function<ViewNode()>;
+  CancelToken() : flag_{std::make_shared<std::atomic<bool>>(false)} {}
 
-  explicit ViewInstance(ViewFn fn) : fn_{std::move(fn)} { rebuild(); }
+  bool cancelled() const { return flag_->load(std::memory_order_acquire); }
 
-  const ViewNode &tree() const { return tree_; }
+  void cancel() const { flag_->store(true, std::memory_order_release); }
 
-  const LayoutNode &layout() const { return layout_; }
+private:
+  std::shared_ptr<std::atomic<bool>> flag_;
+};
 
-  const std::vector<RenderOp> &render_ops() const { return render_ops_; }
+inline ThreadPool &async_pool() {
+  static ThreadPool pool{std::max<std::size_t>(2, ThreadPool::default_threads())};
+  return pool;
+}
 
-  void set_env_value(std::string key, PropValue value) {
-    env_values_.insert_or_assign(std::move(key), std::move(value));
-    dirty_ = true;
+// The base key is borrowed, not copied: the characters it points at must
+// outlive the StateKey. Suffixes added with with() are owned.
+class StateKey {
+public:
+  constexpr StateKey(const char *key) : StateKey{std::string_view{key}} {}
+  constexpr StateKey(std::string_view key)
+      : base_{key}, hash_{mix(kOffset, key)} {}
+  StateKey(const std::string &key) : StateKey{std::string_view{key}} {}
+  StateKey(std::string &&) = delete;
+
+  static constexpr StateKey seeded(std::string_view key, std::uint64_t seed) {
+    StateKey k{key};
+    k.hash_ = mix(seed, key);
+    return k;
   }
 
-  const PropValue *env_value(const std::string &key) const {
-    const auto it = env_values_.find(key);
-    return it == env_values_.end() ? nullptr : &it->second;
+  constexpr StateKey with(std::string_view suffix) const {
+    StateKey k{*this};
+    k.suffix_.append(suffix);
+    k.hash_ = mix(hash_, suffix);
+    return k;
   }
 
-  void set_env_object(std::string key, std::shared_ptr<void> obj) {
-    env_objects_.insert_or_assign(std::move(key), std::move(obj));
-    dirty_ = true;
+  constexpr std::uint64_t hash() const { return hash_; }
+
+  constexpr std::size_t size() const { return base_.size() + suffix_.size(); }
+
+  constexpr bool equals(std::string_view s) const {
+    return s.size() == size() && s.substr(0, base_.size()) == base_ &&
+           s.substr(base_.size()) == suffix_;
   }
 
-  std::shared_ptr<void> env_object(const std::string &key) const {
-    const auto it = env_objects_.find(key);
-    return it == env_objects_.end() ? std::shared_ptr<void>{} : it->second;
+  std::string str() const {
+    std::string out;
+    out.reserve(size());
+    out.append(base_);
+    out.append(suffix_);
+    return out;
   }
 
-  void invoke_handler(std::uint64_t handler_id) {
-    if (handler_id == 0) {
-      return;
+private:
+  static constexpr std::uint64_t kOffset = 14695981039346656037ull;
+
+  static constexpr std::uint64_t mix(std::uint64_t h, std::string_view s) {
+    for (const char c : s) {
+      h ^= static_cast<unsigned char>(c);
+      h *= 1099511628211ull;
+    }
+    return h;
+  }
+
+  std::string_view base_{};
+  std::string suffix_{};
+  std::uint64_t hash_{};
+};
+
+namespace detail {
+
+template <typename T> inline constexpr char state_type_tag = 0;
+
+class LocalStateTable {
+public:
+  struct Slot {
+    std::uint64_t hash{};
+    std::string key{};
+    const void *type{};
+    std::shared_ptr<StateBase> state{};
+    std::uint64_t build{};
+    std::size_t bytes{};
+  };
+
+  std::size_t size() const { return size_; }
+  std::size_t capacity() const { return slots_.size(); }
+
+  Slot *find(const StateKey &key) {
+    if (slots_.empty()) {
+      return nullptr;
     }
-    const auto it = handlers_.find(handler_id);
-    if (it != handlers_.end() && it->second) {
-      it->second();
+    const auto hash = key.hash();
+    for (auto i = home(hash);; i = (i + 1) & mask()) {
+      auto &s = slots_[i];
+      if (!s.state) {
+        return nullptr;
+      }
+      if (s.hash == hash && key.equals(s.key)) {
+        return &s;
+      }
     }
   }
 
-  std::optional<RectF>
-  layout_frame_at_path(const std::vector<std::size_t> &path) const {
-    const auto *ln = layout_at_path(layout_, path);
-    if (!ln) {
-      return std::nullopt;
+  void insert(Slot slot) {
+    if ((size_ + 1) * 2 > slots_.size()) {
+      rehash(std::max<std::size_t>(16, slots_.size() * 2));
     }
-    return ln->frame;
+    place(std::move(slot));
+    ++size_;
   }
 
-  std::optional<std::vector<std::size_t>> path_by_key(const std::string &key) const {
-    return find_path_by_key(tree_, key);
+  void erase(const StateKey &key) {
+    auto *s = find(key);
+    if (!s) {
+      return;
+    }
+    auto i = static_cast<std::size_t>(s - slots_.data());
+    slots_[i] = Slot{};
+    --size_;
+    for (auto j = (i + 1) & mask(); slots_[j].state; j = (j + 1) & mask()) {
+      const auto k = home(slots_[j].hash);
+      const bool stays = i <= j ? (i < k && k <= j) : (i < k || k <= j);
+      if (stays) {
+        continue;
+      }
+      slots_[i] = std::move(slots_[j]);
+      slots_[j] = Slot{};
+      i = j;
+    }
   }
 
-  std::optional<RectF> layout_frame_by_key(const std::string &key) const {
-    if (auto p = find_path_by_key(tree_, key)) {
-      return layout_frame_at_path(*p);
+  template <typename Pred> std::size_t erase_if(Pred pred) {
+    std::size_t removed = 0;
+    for (auto &s : slots_) {
+      if (s.state && pred(s)) {
+        s = Slot{};
+        ++removed;
+      }
     }
-    return std::nullopt;
+    if (removed) {
+      size_ -= removed;
+      rehash(slots_.size());
+    }
+    return removed;
   }
 
-  std::optional<std::vector<std::size_t>> hit_path(float x, float y) const {
-    if (const auto hit = hit_test(tree_, layout_, x, y)) {
-      return hit->path;
+  template <typename F> void for_each(F &&fn) const {
+    for (const auto &s : slots_) {
+      if (s.state) {
+        fn(s);
+      }
     }
-    return std::nullopt;
   }
 
-  std::string hit_key(float x, float y) const {
-    if (auto p = hit_path(x, y)) {
-      auto path = *p;
-      for (;;) {
-        if (const auto *vn = node_at_path(tree_, path)) {
-          if (!vn->key.empty()) {
-            return vn->key;
+private:
+  std::size_t mask() const { return slots_.size() - 1; }
+
+  std::size_t home(std::uint64_t hash) const {
+    return static_cast<std::size_t>((hash * 0x9E3779B97F4A7C15ull) >> 32) &
+           mask();
+  }
+
+  void place(Slot slot) {
+    auto i = home(slot.hash);
+    while (slots_[i].state) {
+      i = (i + 1) & mask();
+    }
+    slots_[i] = std::move(slot);
+  }
+
+  void rehash(std::size_t capacity) {
+    spare_.clear();
+    spare_.resize(capacity);
+    spare_.swap(slots_);
+    for (auto &s : spare_) {
+      if (s.state) {
+        place(std::move(s));
+      }
+    }
+    spare_.clear();
+  }
+
+  std::vector<Slot> slots_{};
+  std::vector<Slot> spare_{};
+  std::size_t size_{};
+};
+
+} // namespace detail
+
+struct DependencyStats {
+  std::size_t tracked{};
+  std::size_t added{};
+  std::size_t removed{};
+};
+
+struct LocalStateRetention {
+  std::uint64_t keep_builds{};
+  bool keep_all{};
+};
+
+struct LocalStateStats {
+  std::size_t slots{};
+  std::size_t bytes{};
+  std::size_t swept{};
+  std::size_t swept_total{};
+};
+
+class ViewInstance {
+public:
+  using ViewFn = std::function<ViewNode()>;
+
+  explicit ViewInstance(ViewFn fn) : fn_{std::move(fn)} { rebuild(); }
+
+  ViewInstance(const ViewInstance &) = delete;
+  ViewInstance &operator=(const ViewInstance &) = delete;
+
+  ~ViewInstance() {
+    for (auto &kv : tasks_) {
+      kv.second.cancel.cancel();
+    }
+  }
+
+  const ViewNode &tree() const { return tree_; }
+
+  const LayoutNode &layout() const { return layout_; }
+
+  SizeF viewport() const { return viewport_; }
+
+  const std::vector<RenderOp> &render_ops() const { return render_ops_; }
+
+  const RenderOpCache &render_cache() const { return render_cache_; }
+
+  const std::vector<RenderTransform> &render_transforms() const {
+    return render_transforms_;
+  }
+
+  bool flush_layout() {
+    if (!std::exchange(layout_pending_, false)) {
+      return false;
+    }
+    layout_ = layout_tree(tree_, viewport_);
+    rebuild_render_ops();
+    layout_flushed_ = true;
+    return true;
+  }
+
+  void set_env_value(std::string key, PropValue value) {
+    env_values_.insert_or_assign(std::move(key), std::move(value));
+    dirty_ = true;
+  }
+
+  const PropValue *env_value(const std::string &key) const {
+    const auto it = env_values_.find(key);
+    return it == env_values_.end() ? nullptr : &it->second;
+  }
+
+  void set_env_object(std::string key, std::shared_ptr<void> obj) {
+    env_objects_.insert_or_assign(std::move(key), std::move(obj));
+    dirty_ = true;
+  }
+
+  std::shared_ptr<void> env_object(const std::string &key) const {
+    const auto it = env_objects_.find(key);
+    return it == env_objects_.end() ? std::shared_ptr<void>{} : it->second;
+  }
+
+  void invoke_handler(std::uint64_t handler_id) { (void)call_slot(handler_id); }
+
+  std::optional<RectF>
+  layout_frame_at_path(const std::vector<std::size_t> &path) const {
+    const auto *ln = layout_at_path(layout_, path);
+    if (!ln) {
+      return std::nullopt;
+    }
+    return ln->frame;
+  }
+
+  std::optional<std::vector<std::size_t>> path_by_key(const std::string &key) const {
+    if (const auto *p = key_index_.find(key)) {
+      return *p;
+    }
+    return std::nullopt;
+  }
+
+  std::optional<RectF> layout_frame_by_key(const std::string &key) const {
+    if (const auto *p = key_index_.find(key)) {
+      return layout_frame_at_path(*p);
+    }
+    return std::nullopt;
+  }
+
+  std::vector<std::string> duplicate_keys() const {
+    return key_index_.duplicates();
+  }
+
+  std::size_t duplicate_key_count() const {
+    return key_index_.duplicate_count();
+  }
+
+  void set_diagnostic_handler(std::function<void(const std::string &)> fn) {
+    diagnostic_handler_ = std::move(fn);
+  }
+
+  std::size_t handlers_reused() const { return handlers_reused_; }
+
+  DependencyStats dependency_stats() const { return dep_stats_; }
+
+  std::optional<std::vector<std::size_t>> hit_path(float x, float y) const {
+    if (const auto hit = hit_test(tree_, layout_, x, y)) {
+      return hit->path;
+    }
+    return std::nullopt;
+  }
+
+  std::string hit_key(float x, float y) const {
+    if (auto p = hit_path(x, y)) {
+      auto path = *p;
+      for (;;) {
+        if (const auto *vn = node_at_path(tree_, path)) {
+          if (!vn->key.empty()) {
+            return vn->key;
           }
         }
         if (path.empty()) {
@@ -1849,6 +2498,10 @@ public:
   }
 
   bool dispatch_click(float x, float y) {
+    if ((event_mask_ & event_bit(EventKind::Click)) == 0) {
+      return false;
+    }
+    flush_layout();
     const auto hit = hit_test(tree_, layout_, x, y);
     if (!hit) {
       return false;
@@ -1861,14 +2514,9 @@ public:
         break;
       }
 
-      const auto it = vn->events.find("click");
-      if (it != vn->events.end() && it->second != 0) {
-        const auto hit_id = it->second;
-        const auto h = handlers_.find(hit_id);
-        if (h != handlers_.end() && h->second) {
-          h->second();
-          return true;
-        }
+      if (vn->events.has(EventKind::Click) &&
+          call_slot(vn->events.get(EventKind::Click))) {
+        return true;
       }
 
       if (path.empty()) {
@@ -1882,12 +2530,14 @@ public:
 
   bool dispatch_pointer_down(int pointer, float x, float y) {
     pointers_down_.insert(pointer);
-    return dispatch_pointer("pointer_down", pointer, x, y);
+    pointer_velocity_.erase(pointer);
+    return dispatch_pointer(EventKind::PointerDown, pointer, x, y);
   }
 
   bool dispatch_pointer_up(int pointer, float x, float y) {
-    const bool handled = dispatch_pointer("pointer_up", pointer, x, y);
+    const bool handled = dispatch_pointer(EventKind::PointerUp, pointer, x, y);
     pointers_down_.erase(pointer);
+    pointer_velocity_.erase(pointer);
     captures_.erase(pointer);
     return handled;
   }
@@ -1897,19 +2547,23 @@ public:
         captures_.find(pointer) == captures_.end()) {
       return false;
     }
-    return dispatch_pointer("pointer_move", pointer, x, y);
+    return dispatch_pointer(EventKind::PointerMove, pointer, x, y);
+  }
+
+  void set_pointer_velocity(int pointer, float vx, float vy) {
+    pointer_velocity_.insert_or_assign(pointer, PointerVelocity{vx, vy});
   }
 
   bool dispatch_key_down(int key, int scancode, int mods) {
-    return dispatch_key("key_down", key, scancode, 1, mods);
+    return dispatch_key(EventKind::KeyDown, key, scancode, 1, mods);
   }
 
   bool dispatch_key_up(int key, int scancode, int mods) {
-    return dispatch_key("key_up", key, scancode, 0, mods);
+    return dispatch_key(EventKind::KeyUp, key, scancode, 0, mods);
   }
 
   bool dispatch_text_input(std::string text) {
-    return dispatch_text("text_input", std::move(text));
+    return dispatch_text(EventKind::TextInput, std::move(text));
   }
 
   bool dispatch_scroll(float x, float y, float delta_y_px) {
@@ -1958,8 +2612,8 @@ public:
     if (!vn->key.empty()) {
       scroll_offsets_.insert_or_assign(vn->key, next);
     }
-    layout_ = layout_tree(tree_, viewport_);
-    render_ops_ = build_render_ops(tree_, layout_);
+    render_cache_.invalidate(tree_, *sv_path);
+    layout_pending_ = true;
     return true;
   }
 
@@ -1969,6 +2623,9 @@ public:
     CaptureTarget t;
     t.path = path;
     t.key = key;
+    if (const auto *vn = node_at_path(tree_, path)) {
+      t.id = vn->id;
+    }
     captures_.insert_or_assign(pointer, std::move(t));
   }
 
@@ -1979,11 +2636,17 @@ public:
     std::vector<PatchOp> patches;
     bool layout_rebuilt{};
     bool render_rebuilt{};
+    bool transforms_changed{};
   };
 
   UpdateResult update() {
     const double now = now_ms();
 
+    {
+      StateTransaction tx;
+      drain_ui_tasks();
+    }
+
     poll_file_watches(now);
 
     bool any_timeline = false;
@@ -1998,7 +2661,8 @@ public:
       }
       if (now - t.last_ms >= t.interval_ms) {
         t.last_ms = now;
-        auto slot = local_state<double>(t.key + ":timeline_now", now);
+        auto slot =
+            local_state<double>(StateKey{t.key}.with(":timeline_now"), now);
         slot.set(now);
         any_timeline = true;
       }
@@ -2008,11 +2672,21 @@ public:
       return rebuild();
     }
 
+    const bool relayout = std::exchange(layout_pending_, false);
+    const bool flushed = std::exchange(layout_flushed_, false);
+    if (relayout) {
+      layout_ = layout_tree(tree_, viewport_);
+    }
+
     if (!anims_.empty()) {
-      const bool changed = step_animations(now);
+      bool ops_dirty = false;
+      const bool changed = step_animations(now, ops_dirty);
       if (changed) {
-        render_ops_ = build_render_ops(tree_, layout_);
-        return UpdateResult{false, {}, false, true};
+        if (ops_dirty || relayout) {
+          rebuild_render_ops();
+        }
+        return UpdateResult{false, {}, relayout || flushed,
+                            ops_dirty || relayout || flushed, true};
       }
     }
 
@@ -2020,13 +2694,21 @@ public:
       return rebuild();
     }
 
+    if (relayout || flushed) {
+      if (relayout) {
+        rebuild_render_ops();
+      }
+      return UpdateResult{false, {}, true, true};
+    }
     return UpdateResult{false, {}, false, false};
   }
 
   void set_viewport(SizeF viewport) {
     viewport_ = viewport;
+    layout_pending_ = false;
+    layout_flushed_ = false;
     layout_ = layout_tree(tree_, viewport_);
-    render_ops_ = build_render_ops(tree_, layout_);
+    rebuild_render_ops();
   }
 
   void set_pending_animation(AnimationSpec spec) {
@@ -2059,18 +2741,66 @@ public:
     w.on_change = std::move(on_change);
   }
 
-  template <typename T> StateHandle<T> local_state(std::string key, T initial) {
-    const auto it = local_states_.find(key);
-    if (it != local_states_.end()) {
-      if (auto p = std::dynamic_pointer_cast<State<T>>(it->second)) {
-        return StateHandle<T>{std::move(p)};
+  template <typename T> StateHandle<T> local_state(StateKey key, T initial) {
+    const void *type = &detail::state_type_tag<T>;
+    if (auto *slot = local_states_.find(key)) {
+      slot->build = build_count_;
+      if (slot->type == type) {
+        return StateHandle<T>{std::static_pointer_cast<State<T>>(slot->state)};
       }
+      auto p = std::make_shared<State<T>>(std::move(initial));
+      slot->type = type;
+      slot->state = p;
+      slot->bytes = sizeof(State<T>);
+      return StateHandle<T>{std::move(p)};
     }
     auto p = std::make_shared<State<T>>(std::move(initial));
-    local_states_.insert_or_assign(std::move(key), p);
+    local_states_.insert(detail::LocalStateTable::Slot{
+        key.hash(), key.str(), type, p, build_count_, sizeof(State<T>)});
     return StateHandle<T>{std::move(p)};
   }
 
+  void set_local_state_retention(LocalStateRetention policy) {
+    retention_ = policy;
+  }
+
+  LocalStateStats local_state_stats() const {
+    auto st = local_stats_;
+    st.slots = local_states_.size();
+    st.bytes = local_states_.capacity() * sizeof(detail::LocalStateTable::Slot);
+    local_states_.for_each(
+        [&](const detail::LocalStateTable::Slot &s) { st.bytes += s.bytes; });
+    return st;
+  }
+
+  template <typename F> auto start_task(std::string key, F fn) {
+    using R = std::decay_t<
+        decltype(detail::invoke_task(std::declval<F &>(), CancelToken{}))>;
+    auto slot = local_state<std::optional<R>>(task_key(key), std::nullopt);
+    auto [it, inserted] = tasks_.try_emplace(std::move(key));
+    it->second.build = build_count_;
+    if (inserted) {
+      async_pool().submit([fn = std::move(fn), cancel = it->second.cancel,
+                           slot]() mutable {
+        if (cancel.cancelled()) {
+          return;
+        }
+        std::optional<R> result;
+        try {
+          result = detail::invoke_task(fn, cancel);
+        } catch (...) {
+          return;
+        }
+        if (!cancel.cancelled()) {
+          slot.set_async(std::move(result));
+        }
+      });
+    }
+    return slot;
+  }
+
+  std::size_t task_count() const { return tasks_.size(); }
+
 private:
   struct PropAnim {
     std::vector<std::size_t> path;
@@ -2080,8 +2810,82 @@ private:
     double start_ms{};
     double duration_ms{};
     double delay_ms{};
+    AnimationCurve curve{AnimationCurve::EaseInOut};
+  };
+
+  struct AnimTarget {
+    std::vector<std::size_t> path;
+    ViewNode *node{};
+    std::vector<std::uint64_t> render_ids;
+    std::uint32_t slot{};
+    std::uint32_t running{};
+    std::uint64_t stamp{};
+  };
+
+  void sweep_local_states() {
+    local_stats_.swept = 0;
+    if (retention_.keep_all) {
+      return;
+    }
+    local_stats_.swept = local_states_.erase_if(
+        [&](const detail::LocalStateTable::Slot &s) {
+          return s.build + retention_.keep_builds < build_count_;
+        });
+    local_stats_.swept_total += local_stats_.swept;
+  }
+
+  static constexpr std::uint64_t kTaskKeySeed = 0x9E3779B97F4A7C15ull;
+
+  static StateKey task_key(std::string_view key) {
+    return StateKey::seeded(key, kTaskKeySeed);
+  }
+
+  void report_duplicate_keys() {
+    if (key_index_.duplicate_count() == 0 && reported_duplicates_.empty()) {
+      return;
+    }
+    std::erase_if(reported_duplicates_, [&](const std::string &key) {
+      return !key_index_.is_duplicate(key);
+    });
+    for (const auto &key : key_index_.duplicates()) {
+      if (reported_duplicates_.insert(key).second) {
+        emit_diagnostic("duplicate view key '" + key + "'");
+      }
+    }
+  }
+
+  void emit_diagnostic(const std::string &message) {
+    if (diagnostic_handler_) {
+      diagnostic_handler_(message);
+      return;
+    }
+#ifndef NDEBUG
+    std::fprintf(stderr, "duorou: %s\n", message.c_str());
+#endif
+  }
+
+  struct PointerVelocity {
+    float x{};
+    float y{};
   };
 
+  struct TaskReg {
+    CancelToken cancel{};
+    std::uint64_t build{};
+  };
+
+  void sweep_tasks() {
+    for (auto it = tasks_.begin(); it != tasks_.end();) {
+      if (it->second.build == build_count_) {
+        ++it;
+        continue;
+      }
+      it->second.cancel.cancel();
+      local_states_.erase(task_key(it->first));
+      it = tasks_.erase(it);
+    }
+  }
+
   struct TimelineReg {
     std::string key;
     double interval_ms{};
@@ -2168,6 +2972,8 @@ private:
               affects = prop_affects_layout(op.key);
             } else if constexpr (std::is_same_v<T, PatchRemoveProp>) {
               affects = prop_affects_layout(op.key);
+            } else if constexpr (std::is_same_v<T, PatchSetKey>) {
+              affects = false;
             } else {
               affects = true;
             }
@@ -2185,7 +2991,39 @@ private:
       return true;
     }
     return k == "opacity" || k == "render_offset_x" || k == "render_offset_y" ||
-           k == "border_width";
+           k == "render_scale" || k == "border_width";
+  }
+
+  static const std::vector<std::string> &anim_prop_names() {
+    static const std::vector<std::string> names{
+        "opacity", "render_offset_x", "render_offset_y", "render_scale",
+        "border_width", "bg", "border", "color", "tint", "track", "fill",
+        "scrollbar_track", "scrollbar_thumb"};
+    return names;
+  }
+
+  static std::uint16_t anim_prop_atom(const std::string &k) {
+    const auto &names = anim_prop_names();
+    return static_cast<std::uint16_t>(
+        std::find(names.begin(), names.end(), k) - names.begin());
+  }
+
+  static bool prop_is_transform_key(const std::string &k) {
+    return k == "opacity" || k == "render_offset_x" || k == "render_offset_y" ||
+           k == "render_scale";
+  }
+
+  static void set_transform_field(RenderTransform &t, const std::string &key,
+                                  float v) {
+    if (key == "opacity") {
+      t.opacity = v;
+    } else if (key == "render_offset_x") {
+      t.dx = v;
+    } else if (key == "render_offset_y") {
+      t.dy = v;
+    } else if (key == "render_scale") {
+      t.scale = v;
+    }
   }
 
   static bool prop_can_interpolate(const std::string &key, const PropValue &a,
@@ -2233,63 +3071,6 @@ private:
     return false;
   }
 
-  static std::uint32_t pack_color_u32(ColorU8 c) {
-    return static_cast<std::uint32_t>(c.r) |
-           (static_cast<std::uint32_t>(c.g) << 8) |
-           (static_cast<std::uint32_t>(c.b) << 16) |
-           (static_cast<std::uint32_t>(c.a) << 24);
-  }
-
-  static PropValue interpolate_prop(const std::string &key, const PropValue &a,
-                                    const PropValue &b, double t) {
-    t = std::max(0.0, std::min(1.0, t));
-    if (prop_is_color_key(key)) {
-      const auto ca = [&]() -> std::optional<ColorU8> {
-        if (const auto *i = std::get_if<std::int64_t>(&a)) {
-          return color_from_u32(static_cast<std::uint32_t>(
-              static_cast<std::uint64_t>(*i) & 0xFFFFFFFFull));
-        }
-        if (const auto *d = std::get_if<double>(&a)) {
-          return color_from_u32(static_cast<std::uint32_t>(
-              static_cast<std::uint64_t>(*d) & 0xFFFFFFFFull));
-        }
-        return std::nullopt;
-      }();
-      const auto cb = [&]() -> std::optional<ColorU8> {
-        if (const auto *i = std::get_if<std::int64_t>(&b)) {
-          return color_from_u32(static_cast<std::uint32_t>(
-              static_cast<std::uint64_t>(*i) & 0xFFFFFFFFull));
-        }
-        if (const auto *d = std::get_if<double>(&b)) {
-          return color_from_u32(static_cast<std::uint32_t>(
-              static_cast<std::uint64_t>(*d) & 0xFFFFFFFFull));
-        }
-        return std::nullopt;
-      }();
-      if (ca && cb) {
-        auto lerp_u8 = [&](std::uint8_t x, std::uint8_t y) -> std::uint8_t {
-          const double v = static_cast<double>(x) +
-                           (static_cast<double>(y) - static_cast<double>(x)) * t;
-          return clamp_u8(static_cast<int>(std::lround(v)));
-        };
-        ColorU8 c;
-        c.r = lerp_u8(ca->r, cb->r);
-        c.g = lerp_u8(ca->g, cb->g);
-        c.b = lerp_u8(ca->b, cb->b);
-        c.a = lerp_u8(ca->a, cb->a);
-        return PropValue{static_cast<std::int64_t>(pack_color_u32(c))};
-      }
-    }
-
-    double da = 0.0;
-    double db = 0.0;
-    if (prop_as_double_any(a, da) && prop_as_double_any(b, db)) {
-      return PropValue{da + (db - da) * t};
-    }
-
-    return b;
-  }
-
   static std::optional<AnimationSpec> animation_spec_from_node(const ViewNode &v) {
     if (!prop_as_bool(v.props, "animation_enabled", false)) {
       return std::nullopt;
@@ -2319,46 +3100,192 @@ private:
     return std::nullopt;
   }
 
-  bool step_animations(double now) {
-    bool changed = false;
-    std::vector<PropAnim> keep;
-    keep.reserve(anims_.size());
-    for (auto &a : anims_) {
-      if (a.path.empty() && a.prop_key.empty()) {
-        continue;
+  void rebuild_render_ops() {
+    render_ops_ = build_render_ops(tree_, layout_, render_cache_,
+                                   std::move(render_ops_));
+  }
+
+  bool transform_promotable(const std::vector<std::size_t> &path) const {
+    const ViewNode *v = &tree_;
+    for (const auto idx : path) {
+      if (prop_as_float(v->props, "render_scale", 1.0f) != 1.0f ||
+          prop_as_bool(v->props, "drawing_group", false) ||
+          detail::render_transform_slot(*v) != 0) {
+        return false;
       }
-      const double t0 = a.start_ms + a.delay_ms;
-      if (now < t0) {
-        keep.push_back(a);
-        continue;
+      if (idx >= v->children.size()) {
+        return false;
       }
-      const double denom = std::max(1e-6, a.duration_ms);
-      const double t = (now - t0) / denom;
+      v = &v->children[idx];
+    }
+    return detail::render_transform_slot(*v) == 0;
+  }
+
+  static bool anim_color_value(const PropValue &v, std::uint32_t &out) {
+    if (const auto *i = std::get_if<std::int64_t>(&v)) {
+      out = static_cast<std::uint32_t>(static_cast<std::uint64_t>(*i) &
+                                       0xFFFFFFFFull);
+      return true;
+    }
+    if (const auto *d = std::get_if<double>(&v)) {
+      out = static_cast<std::uint32_t>(static_cast<std::uint64_t>(*d) &
+                                       0xFFFFFFFFull);
+      return true;
+    }
+    return false;
+  }
+
+  void start_animations(std::vector<PropAnim> scheduled) {
+    anims_.clear();
+    anim_targets_.clear();
+    render_transforms_.assign(1, RenderTransform{});
+    if (scheduled.empty()) {
+      return;
+    }
+    anims_.reserve(scheduled.size());
+
+    std::unordered_map<NodeId, std::uint32_t> handles;
+    for (auto &a : scheduled) {
       auto *vn = node_at_path_mut(tree_, a.path);
       if (!vn) {
         continue;
       }
-      const auto next = interpolate_prop(a.prop_key, a.from, a.to, t);
-      vn->props.insert_or_assign(a.prop_key, next);
-      changed = true;
-      if (t < 1.0) {
-        keep.push_back(a);
+      auto it = handles.find(vn->id);
+      if (it == handles.end()) {
+        AnimTarget t;
+        t.path = a.path;
+        t.node = vn;
+        t.render_ids = RenderOpCache::path_identities(tree_, a.path);
+        anim_targets_.push_back(std::move(t));
+        it = handles
+                 .emplace(vn->id,
+                          static_cast<std::uint32_t>(anim_targets_.size() - 1))
+                 .first;
+      }
+
+      AnimationEngine::Track t;
+      t.target = it->second;
+      t.prop = anim_prop_atom(a.prop_key);
+      t.start_ms = a.start_ms + a.delay_ms;
+      t.duration_ms = a.duration_ms;
+      t.curve = a.curve;
+      if (t.prop >= anim_prop_names().size()) {
+        continue;
+      }
+      double from = 0.0;
+      double to = 0.0;
+      if (prop_is_color_key(a.prop_key)) {
+        t.color = anim_color_value(a.from, t.from_rgba) &&
+                  anim_color_value(a.to, t.to_rgba);
+        if (!t.color) {
+          t.duration_ms = 0.0;
+        }
+      } else if (prop_as_double_any(a.from, from) &&
+                 prop_as_double_any(a.to, to)) {
+        t.from = static_cast<float>(from);
+        t.to = static_cast<float>(to);
+      } else {
+        t.duration_ms = 0.0;
+      }
+      t.final_value = std::move(a.to);
+      anims_.add(std::move(t));
+      ++anim_targets_[it->second].running;
+    }
+
+    std::vector<std::uint32_t> order;
+    for (std::size_t i = 0; i < anims_.size(); ++i) {
+      if (prop_is_transform_key(anim_prop_names()[anims_.prop(i)])) {
+        order.push_back(anims_.target(i));
+      }
+    }
+    std::sort(order.begin(), order.end(), [&](std::uint32_t a, std::uint32_t b) {
+      return anim_targets_[a].path.size() < anim_targets_[b].path.size() ||
+             (anim_targets_[a].path.size() == anim_targets_[b].path.size() &&
+              a < b);
+    });
+    order.erase(std::unique(order.begin(), order.end()), order.end());
+    for (const auto h : order) {
+      auto &tg = anim_targets_[h];
+      if (!transform_promotable(tg.path)) {
+        continue;
+      }
+      const auto &props = tg.node->props;
+      RenderTransform t;
+      t.dx = prop_as_float(props, "render_offset_x", 0.0f);
+      t.dy = prop_as_float(props, "render_offset_y", 0.0f);
+      t.scale = prop_as_float(props, "render_scale", 1.0f);
+      t.opacity = prop_as_float(props, "opacity", 1.0f);
+      tg.slot = static_cast<std::uint32_t>(render_transforms_.size());
+      render_transforms_.push_back(t);
+      tg.node->props.insert_or_assign(
+          "render_transform", PropValue{static_cast<std::int64_t>(tg.slot)});
+      render_cache_.invalidate(tg.render_ids);
+    }
+  }
+
+  bool step_animations(double now, bool &ops_dirty) {
+    if (anims_.empty()) {
+      return false;
+    }
+    anims_.evaluate(now);
+    ++anim_stamp_;
+    const auto &names = anim_prop_names();
+    bool changed = false;
+    for (std::size_t i = 0; i < anims_.size();) {
+      if (!anims_.started(i)) {
+        ++i;
+        continue;
+      }
+      auto &tg = anim_targets_[anims_.target(i)];
+      const auto &key = names[anims_.prop(i)];
+      const bool done = anims_.finished(i);
+      float value = anims_.value(i);
+      if (done) {
+        tg.node->props.insert_or_assign(key, anims_.final_value(i));
+        value = prop_as_float(tg.node->props, key, value);
+      } else if (anims_.color(i)) {
+        tg.node->props.insert_or_assign(
+            key, PropValue{static_cast<std::int64_t>(anims_.color_value(i))});
       } else {
-        vn->props.insert_or_assign(a.prop_key, a.to);
+        tg.node->props.insert_or_assign(key,
+                                        PropValue{static_cast<double>(value)});
+      }
+      changed = true;
+
+      if (tg.slot != 0) {
+        set_transform_field(render_transforms_[tg.slot], key, value);
+      } else if (tg.stamp != anim_stamp_) {
+        tg.stamp = anim_stamp_;
+        render_cache_.invalidate(tg.render_ids);
+        ops_dirty = true;
+      }
+
+      if (!done) {
+        ++i;
+        continue;
+      }
+      anims_.remove(i);
+      if (--tg.running == 0 && tg.slot != 0) {
+        tg.node->props.erase("render_transform");
+        render_transforms_[tg.slot] = RenderTransform{};
+        tg.slot = 0;
+        render_cache_.invalidate(tg.render_ids);
+        ops_dirty = true;
       }
     }
-    anims_ = std::move(keep);
     return changed;
   }
 
   struct CaptureTarget {
     std::vector<std::size_t> path;
     std::string key;
+    NodeId id{};
   };
 
   struct FocusTarget {
     std::vector<std::size_t> path;
     std::string key;
+    NodeId id{};
   };
 
   struct HitResult {
@@ -2441,16 +3368,13 @@ private:
     if (v.type == "TextField" || v.type == "TextEditor") {
       return true;
     }
-    if (const auto it = v.events.find("key_down");
-        it != v.events.end() && it->second != 0) {
+    if (v.events.has(EventKind::KeyDown)) {
       return true;
     }
-    if (const auto it = v.events.find("key_up");
-        it != v.events.end() && it->second != 0) {
+    if (v.events.has(EventKind::KeyUp)) {
       return true;
     }
-    if (const auto it = v.events.find("text_input");
-        it != v.events.end() && it->second != 0) {
+    if (v.events.has(EventKind::TextInput)) {
       return true;
     }
     return false;
@@ -2535,14 +3459,14 @@ private:
     return hit_test_impl(root, layout_root, x, y, layout_root.frame, path);
   }
 
-  static bool find_path_by_key_impl(const ViewNode &v, const std::string &key,
-                                    std::vector<std::size_t> &path) {
-    if (!key.empty() && v.key == key) {
+  static bool find_path_by_id_impl(const ViewNode &v, NodeId id,
+                                   std::vector<std::size_t> &path) {
+    if (v.id == id) {
       return true;
     }
     for (std::size_t i = 0; i < v.children.size(); ++i) {
       path.push_back(i);
-      if (find_path_by_key_impl(v.children[i], key, path)) {
+      if (find_path_by_id_impl(v.children[i], id, path)) {
         return true;
       }
       path.pop_back();
@@ -2551,12 +3475,12 @@ private:
   }
 
   static std::optional<std::vector<std::size_t>>
-  find_path_by_key(const ViewNode &root, const std::string &key) {
-    if (key.empty()) {
+  find_path_by_id(const ViewNode &root, NodeId id) {
+    if (id == 0) {
       return std::nullopt;
     }
     std::vector<std::size_t> path;
-    if (!find_path_by_key_impl(root, key, path)) {
+    if (!find_path_by_id_impl(root, id, path)) {
       return std::nullopt;
     }
     return path;
@@ -2564,43 +3488,73 @@ private:
 
   std::optional<std::vector<std::size_t>>
   resolve_target_path(const std::vector<std::size_t> &path,
-                      const std::string &key) {
+                      const std::string &key, NodeId id) {
+    if (id != 0) {
+      if (const auto *vn = node_at_path(tree_, path); vn && vn->id == id) {
+        return path;
+      }
+    }
     if (!key.empty()) {
-      if (const auto kp = find_path_by_key(tree_, key)) {
+      if (const auto *kp = key_index_.find(key)) {
         return *kp;
       }
       return std::nullopt;
     }
+    if (const auto ip = find_path_by_id(tree_, id)) {
+      return *ip;
+    }
     return path;
   }
 
-  bool dispatch_bubble(const std::string &event_name,
-                       detail::EventDispatchContext &ctx,
+  static std::uint16_t collect_event_mask(const ViewNode &v) {
+    auto mask = v.events.mask;
+    for (const auto &c : v.children) {
+      mask = static_cast<std::uint16_t>(mask | collect_event_mask(c));
+    }
+    return mask;
+  }
+
+  bool call_slot(std::uint64_t handler_id) {
+    if (handler_id == 0 || handler_id > handlers_.size()) {
+      return false;
+    }
+    auto &fn = handlers_[handler_id - 1];
+    if (!fn) {
+      return false;
+    }
+    StateTransaction tx;
+    fn();
+    return true;
+  }
+
+  bool dispatch_bubble(EventKind kind, detail::EventDispatchContext &ctx,
                        std::vector<std::size_t> path) {
-    detail::active_dispatch_context = &ctx;
-    for (;;) {
-      const auto *vn = node_at_path(tree_, path);
-      if (!vn) {
-        break;
+    if ((event_mask_ & event_bit(kind)) == 0) {
+      return false;
+    }
+    std::vector<const ViewNode *> chain;
+    chain.reserve(path.size() + 1);
+    chain.push_back(&tree_);
+    for (const auto idx : path) {
+      if (idx >= chain.back()->children.size()) {
+        return false;
       }
+      chain.push_back(&chain.back()->children[idx]);
+    }
 
-      const auto it = vn->events.find(event_name);
-      if (it != vn->events.end() && it->second != 0) {
-        ctx.target_path = path;
-        ctx.target_key = vn->key;
-        const auto handle_id = it->second;
-        const auto h = handlers_.find(handle_id);
-        if (h != handlers_.end() && h->second) {
-          h->second();
-          detail::active_dispatch_context = nullptr;
-          return true;
-        }
+    detail::active_dispatch_context = &ctx;
+    for (std::size_t depth = chain.size(); depth-- > 0;) {
+      const auto *vn = chain[depth];
+      if (!vn->events.has(kind)) {
+        continue;
       }
-
-      if (path.empty()) {
-        break;
+      path.resize(depth);
+      ctx.target_path = path;
+      ctx.target_key = vn->key;
+      if (call_slot(vn->events.get(kind))) {
+        detail::active_dispatch_context = nullptr;
+        return true;
       }
-      path.pop_back();
     }
     detail::active_dispatch_context = nullptr;
     return false;
@@ -2610,7 +3564,7 @@ private:
     if (!focus_) {
       return std::nullopt;
     }
-    if (auto p = resolve_target_path(focus_->path, focus_->key)) {
+    if (auto p = resolve_target_path(focus_->path, focus_->key, focus_->id)) {
       return p;
     }
     focus_.reset();
@@ -2627,6 +3581,7 @@ private:
       FocusTarget t;
       t.path = *path;
       t.key = vn->key;
+      t.id = vn->id;
       next = std::move(t);
     }
 
@@ -2643,7 +3598,7 @@ private:
     if (prev_path) {
       detail::EventDispatchContext ctx;
       ctx.instance = this;
-      dispatch_bubble("blur", ctx, *prev_path);
+      dispatch_bubble(EventKind::Blur, ctx, *prev_path);
     }
 
     focus_ = std::move(next);
@@ -2651,7 +3606,7 @@ private:
     if (path) {
       detail::EventDispatchContext ctx;
       ctx.instance = this;
-      dispatch_bubble("focus", ctx, *path);
+      dispatch_bubble(EventKind::Focus, ctx, *path);
     }
   }
 
@@ -2675,26 +3630,32 @@ private:
     set_focus(std::nullopt);
   }
 
-  bool dispatch_pointer(const std::string &event_name, int pointer, float x,
-                        float y) {
-    if ((event_name == "pointer_move" || event_name == "pointer_up") &&
-        update_scroll_from_drag(event_name, pointer, x, y)) {
+  bool dispatch_pointer(EventKind kind, int pointer, float x, float y) {
+    if ((kind == EventKind::PointerMove || kind == EventKind::PointerUp) &&
+        update_scroll_from_drag(kind, pointer, x, y)) {
       return true;
     }
+    flush_layout();
 
     detail::EventDispatchContext ctx;
     ctx.pointer_id = pointer;
     ctx.x = x;
     ctx.y = y;
+    if (const auto vit = pointer_velocity_.find(pointer);
+        vit != pointer_velocity_.end()) {
+      ctx.velocity_x = vit->second.x;
+      ctx.velocity_y = vit->second.y;
+    }
     ctx.instance = this;
 
     if (const auto cap_it = captures_.find(pointer);
         cap_it != captures_.end()) {
-      auto path = resolve_target_path(cap_it->second.path, cap_it->second.key);
+      auto path = resolve_target_path(cap_it->second.path, cap_it->second.key,
+                                      cap_it->second.id);
       if (!path) {
         captures_.erase(pointer);
       } else {
-        if (event_name == "pointer_down") {
+        if (kind == EventKind::PointerDown) {
           focus_from_hit_path(*path);
         }
 
@@ -2703,15 +3664,9 @@ private:
           ctx.target_path = *path;
           ctx.target_key = vn->key;
           detail::active_dispatch_context = &ctx;
-          const auto it = vn->events.find(event_name);
-          if (it != vn->events.end() && it->second != 0) {
-            const auto handle_id = it->second;
-            const auto h = handlers_.find(handle_id);
-            if (h != handlers_.end() && h->second) {
-              h->second();
-              detail::active_dispatch_context = nullptr;
-              return true;
-            }
+          if (vn->events.has(kind) && call_slot(vn->events.get(kind))) {
+            detail::active_dispatch_context = nullptr;
+            return true;
           }
           detail::active_dispatch_context = nullptr;
           return false;
@@ -2719,8 +3674,13 @@ private:
       }
     }
 
+    if (kind == EventKind::PointerMove &&
+        (event_mask_ & event_bit(kind)) == 0) {
+      return false;
+    }
+
     const auto hit = hit_test(tree_, layout_, x, y);
-    if (event_name == "pointer_down") {
+    if (kind == EventKind::PointerDown) {
       focus_from_hit_path(hit ? std::optional{hit->path} : std::nullopt);
     }
 
@@ -2728,13 +3688,14 @@ private:
       return false;
     }
 
-    if (event_name == "pointer_down") {
+    if (kind == EventKind::PointerDown) {
       if (auto sv_path = scrollview_path_from_hit(hit->path)) {
         const auto *sv = node_at_path(tree_, *sv_path);
         if (sv) {
           ScrollDrag d;
           d.path = *sv_path;
           d.key = sv->key;
+          d.id = sv->id;
           d.start_x = x;
           d.start_y = y;
           d.last_x = x;
@@ -2761,12 +3722,13 @@ private:
       }
     }
 
-    return dispatch_bubble(event_name, ctx, hit->path);
+    return dispatch_bubble(kind, ctx, hit->path);
   }
 
   struct ScrollDrag {
     std::vector<std::size_t> path;
     std::string key;
+    NodeId id{};
     float start_x{};
     float start_y{};
     float last_x{};
@@ -2812,14 +3774,14 @@ private:
     }
   }
 
-  bool update_scroll_from_drag(const std::string &event_name, int pointer,
-                               float x, float y) {
+  bool update_scroll_from_drag(EventKind kind, int pointer, float x, float y) {
     const auto it = scroll_drags_.find(pointer);
     if (it == scroll_drags_.end()) {
       return false;
     }
 
-    auto path = resolve_target_path(it->second.path, it->second.key);
+    auto path = resolve_target_path(it->second.path, it->second.key,
+                                    it->second.id);
     if (!path) {
       scroll_drags_.erase(pointer);
       return false;
@@ -2831,7 +3793,7 @@ private:
       return false;
     }
 
-    if (event_name == "pointer_move") {
+    if (kind == EventKind::PointerMove) {
       it->second.last_x = x;
       it->second.last_y = y;
       const float dx = x - it->second.start_x;
@@ -2886,6 +3848,7 @@ private:
       if (allow_y) {
         vn->props.insert_or_assign("scroll_y", PropValue{next_scroll_y});
       }
+      render_cache_.invalidate(tree_, *path);
       if (!vn->key.empty()) {
         if (allow_x) {
           scroll_offsets_x_.insert_or_assign(vn->key, next_scroll_x);
@@ -2894,12 +3857,11 @@ private:
           scroll_offsets_.insert_or_assign(vn->key, next_scroll_y);
         }
       }
-      layout_ = layout_tree(tree_, viewport_);
-      render_ops_ = build_render_ops(tree_, layout_);
+      layout_pending_ = true;
       return true;
     }
 
-    if (event_name == "pointer_up") {
+    if (kind == EventKind::PointerUp) {
       const bool was_drag = it->second.activated;
       scroll_drags_.erase(pointer);
       if (was_drag) {
@@ -2912,8 +3874,8 @@ private:
     return false;
   }
 
-  bool dispatch_key(const std::string &event_name, int key, int scancode,
-                    int action, int mods) {
+  bool dispatch_key(EventKind kind, int key, int scancode, int action,
+                    int mods) {
     auto path = focus_path();
     if (!path) {
       return false;
@@ -2925,10 +3887,10 @@ private:
     ctx.scancode = scancode;
     ctx.action = action;
     ctx.mods = mods;
-    return dispatch_bubble(event_name, ctx, *path);
+    return dispatch_bubble(kind, ctx, *path);
   }
 
-  bool dispatch_text(const std::string &event_name, std::string text) {
+  bool dispatch_text(EventKind kind, std::string text) {
     auto path = focus_path();
     if (!path) {
       return false;
@@ -2937,25 +3899,64 @@ private:
     detail::EventDispatchContext ctx;
     ctx.instance = this;
     ctx.text = std::move(text);
-    return dispatch_bubble(event_name, ctx, *path);
+    return dispatch_bubble(kind, ctx, *path);
   }
 
-  struct DepEntry {
-    StateBase *state{};
-    std::uint64_t version{};
-    Subscription sub;
-  };
-
   bool deps_changed() const {
-    for (const auto &d : deps_) {
-      if (!d.state) {
-        continue;
-      }
-      if (d.state->version() != d.version) {
-        return true;
+    const auto n = dep_states_.size();
+    const auto *states = dep_states_.data();
+    const auto *versions = dep_versions_.data();
+    std::uint64_t diff = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+      diff |= states[i]->version() ^ versions[i];
+    }
+    return diff != 0;
+  }
+
+  void update_dependencies(const std::vector<StateBase *> &next) {
+    auto &states = dep_scratch_states_;
+    auto &versions = dep_scratch_versions_;
+    auto &subs = dep_scratch_subs_;
+    states.clear();
+    versions.clear();
+    subs.clear();
+    states.reserve(next.size());
+    versions.reserve(next.size());
+    subs.reserve(next.size());
+
+    DependencyStats st;
+    std::size_t i = 0;
+    for (auto *s : next) {
+      while (i < dep_states_.size() && dep_states_[i] < s) {
+        dep_subs_[i].reset();
+        ++st.removed;
+        ++i;
+      }
+      states.push_back(s);
+      versions.push_back(s->version());
+      if (i < dep_states_.size() && dep_states_[i] == s &&
+          dep_subs_[i].active()) {
+        subs.push_back(std::move(dep_subs_[i]));
+        ++i;
+      } else {
+        if (i < dep_states_.size() && dep_states_[i] == s) {
+          dep_subs_[i].reset();
+          ++i;
+        }
+        subs.push_back(s->subscribe([this]() { dirty_ = true; }, this));
+        ++st.added;
       }
     }
-    return false;
+    for (; i < dep_states_.size(); ++i) {
+      dep_subs_[i].reset();
+      ++st.removed;
+    }
+
+    dep_states_.swap(states);
+    dep_versions_.swap(versions);
+    dep_subs_.swap(subs);
+    st.tracked = dep_states_.size();
+    dep_stats_ = st;
   }
 
   UpdateResult rebuild() {
@@ -2963,13 +3964,20 @@ private:
     auto old_layout = layout_;
 
     detail::EventCollector event_collector;
+    event_collector.handlers = std::move(spare_handlers_);
+    event_collector.handlers.clear();
+    event_collector.previous = &handlers_;
+    event_collector.previous_stable = &stable_handlers_;
 
     env_values_.clear();
     env_objects_.clear();
     timelines_.clear();
     file_watches_.clear();
+    ++build_count_;
 
     detail::DependencyCollector collector;
+    collector.states = std::move(dep_collect_);
+    collector.states.clear();
     detail::active_collector = &collector;
     detail::active_event_collector = &event_collector;
     detail::active_build_instance = this;
@@ -2978,10 +3986,10 @@ private:
       if (const auto *s = std::get_if<std::string>(pv)) {
         if (*s != style_toml_cache_) {
           style_toml_cache_ = *s;
-          style_rules_cache_ = detail::parse_stylesheet_toml(style_toml_cache_);
+          style_index_.assign(detail::parse_stylesheet_toml(style_toml_cache_));
         }
-        if (!style_rules_cache_.empty()) {
-          detail::apply_styles_to_tree(new_tree, style_rules_cache_);
+        if (!style_index_.empty()) {
+          detail::apply_styles_to_tree(new_tree, style_index_);
         }
       }
     }
@@ -3010,14 +4018,35 @@ private:
         state_key = std::string{"node:"} + std::to_string(node.id);
       }
 
-      auto focused = local_state<bool>(state_key + ":focused", false);
-      auto caret = local_state<std::int64_t>(state_key + ":caret", 0);
-      auto sel_anchor = local_state<std::int64_t>(state_key + ":sel_anchor", 0);
-      auto sel_end = local_state<std::int64_t>(state_key + ":sel_end", 0);
+      const StateKey slot_key{state_key};
+      auto focused = local_state<bool>(slot_key.with(":focused"), false);
+      auto caret = local_state<std::int64_t>(slot_key.with(":caret"), 0);
+      auto sel_anchor =
+          local_state<std::int64_t>(slot_key.with(":sel_anchor"), 0);
+      auto sel_end = local_state<std::int64_t>(slot_key.with(":sel_end"), 0);
 
       const auto padding = prop_as_float(node.props, "padding", 10.0f);
       const auto font_px = prop_as_float(node.props, "font_size", 16.0f);
 
+      std::uint64_t signature = stable_node_id(
+          static_cast<std::uint64_t>(*binding_raw), state_key, 0, node.type);
+      signature = stable_node_id(
+          signature, {},
+          (static_cast<std::size_t>(std::bit_cast<std::uint32_t>(padding))
+           << 32) |
+              std::bit_cast<std::uint32_t>(font_px),
+          {});
+      for (const StateBase *st : {focused.base(), caret.base(),
+                                  sel_anchor.base(), sel_end.base()}) {
+        signature = stable_node_id(
+            signature, {}, reinterpret_cast<std::uintptr_t>(st), {});
+      }
+      auto bind_event = [&](EventKind kind, auto &&fn) {
+        node.events.set(kind, event_collector.add_stable(
+                                  node.id, kind, signature,
+                                  std::forward<decltype(fn)>(fn)));
+      };
+
       {
         auto s = binding_get(binding);
         node.props.insert_or_assign("value", PropValue{s});
@@ -3027,420 +4056,431 @@ private:
         node.props.insert_or_assign("sel_end", PropValue{sel_end.get()});
       }
 
-      if (auto it = node.events.find("focus");
-          it == node.events.end() || it->second == 0) {
-        node.events.insert_or_assign(
-            "focus", event_collector.add([focused, caret, sel_anchor, sel_end,
-                                          binding]() mutable {
-              focused.set(true);
-              const auto next = utf8_count(binding_get(binding));
-              caret.set(next);
-              sel_anchor.set(next);
-              sel_end.set(next);
-            }));
+      if (!node.events.has(EventKind::Focus)) {
+        bind_event(EventKind::Focus, [focused, caret, sel_anchor, sel_end,
+                                      binding]() mutable {
+          focused.set(true);
+          const auto next = utf8_count(binding_get(binding));
+          caret.set(next);
+          sel_anchor.set(next);
+          sel_end.set(next);
+        });
       }
-      if (auto it = node.events.find("blur");
-          it == node.events.end() || it->second == 0) {
-        node.events.insert_or_assign(
-            "blur", event_collector.add([focused]() mutable { focused.set(false); }));
+      if (!node.events.has(EventKind::Blur)) {
+        bind_event(EventKind::Blur,
+                   [focused]() mutable { focused.set(false); });
       }
 
-      if (auto it = node.events.find("pointer_down");
-          it == node.events.end() || it->second == 0) {
+      if (!node.events.has(EventKind::PointerDown)) {
         if (node.type == "TextField") {
-          node.events.insert_or_assign(
-              "pointer_down",
-              event_collector.add([caret, sel_anchor, sel_end, binding, padding,
-                                   font_px]() mutable {
-                auto r = target_frame();
-                if (!r) {
-                  return;
-                }
-                const float char_w = font_px * 0.5f;
-                const float local_x = pointer_x() - (r->x + padding);
-                const auto len = utf8_count(binding_get(binding));
-                auto pos = static_cast<std::int64_t>(
-                    std::round(char_w > 0.0f ? (local_x / char_w) : 0.0f));
-                pos = std::max<std::int64_t>(0, std::min(pos, len));
-                caret.set(pos);
-                sel_anchor.set(pos);
-                sel_end.set(pos);
-                capture_pointer();
-              }));
+          bind_event(EventKind::PointerDown, [caret, sel_anchor, sel_end,
+                                              binding, padding,
+                                              font_px]() mutable {
+            auto r = target_frame();
+            if (!r) {
+              return;
+            }
+            const float char_w = font_px * 0.5f;
+            const float local_x = pointer_x() - (r->x + padding);
+            const auto len = utf8_count(binding_get(binding));
+            auto pos = static_cast<std::int64_t>(
+                std::round(char_w > 0.0f ? (local_x / char_w) : 0.0f));
+            pos = std::max<std::int64_t>(0, std::min(pos, len));
+            caret.set(pos);
+            sel_anchor.set(pos);
+            sel_end.set(pos);
+            capture_pointer();
+          });
         } else {
-          node.events.insert_or_assign(
-              "pointer_down",
-              event_collector.add([caret, sel_anchor, sel_end, binding, padding,
-                                   font_px]() mutable {
-                auto r = target_frame();
-                if (!r) {
-                  return;
-                }
-                const float char_w = font_px * 0.5f;
-                const float line_h = font_px * 1.2f;
-
-                const float local_x = pointer_x() - (r->x + padding);
-                const float local_y = pointer_y() - (r->y + padding);
-                const std::int64_t col = static_cast<std::int64_t>(
-                    std::max(0.0f, std::round(char_w > 0.0f ? (local_x / char_w)
-                                                           : 0.0f)));
-                const std::int64_t row = static_cast<std::int64_t>(
-                    std::max(0.0f, std::floor(line_h > 0.0f ? (local_y / line_h)
-                                                           : 0.0f)));
-
-                auto s = binding_get(binding);
-                struct Line {
-                  std::int64_t start{};
-                  std::int64_t len{};
-                };
-                std::vector<Line> lines;
-                lines.reserve(8);
-                {
-                  std::int64_t start = 0;
-                  std::int64_t cur = 0;
-                  for (std::size_t i = 0; i < s.size();) {
-                    if (s[i] == '\n') {
-                      lines.push_back(Line{start, cur - start});
-                      ++cur;
-                      ++i;
-                      start = cur;
-                      continue;
-                    }
-                    const auto b0 = static_cast<std::uint8_t>(s[i]);
-                    std::size_t adv = 1;
-                    if ((b0 & 0x80) == 0x00) {
-                      adv = 1;
-                    } else if ((b0 & 0xE0) == 0xC0) {
-                      adv = 2;
-                    } else if ((b0 & 0xF0) == 0xE0) {
-                      adv = 3;
-                    } else if ((b0 & 0xF8) == 0xF0) {
-                      adv = 4;
-                    }
-                    if (i + adv > s.size()) {
-                      adv = 1;
-                    }
-                    i += adv;
-                    ++cur;
-                  }
+          bind_event(EventKind::PointerDown, [caret, sel_anchor, sel_end,
+                                              binding, padding,
+                                              font_px]() mutable {
+            auto r = target_frame();
+            if (!r) {
+              return;
+            }
+            const float char_w = font_px * 0.5f;
+            const float line_h = font_px * 1.2f;
+
+            const float local_x = pointer_x() - (r->x + padding);
+            const float local_y = pointer_y() - (r->y + padding);
+            const std::int64_t col = static_cast<std::int64_t>(
+                std::max(0.0f, std::round(char_w > 0.0f ? (local_x / char_w)
+                                                       : 0.0f)));
+            const std::int64_t row = static_cast<std::int64_t>(
+                std::max(0.0f, std::floor(line_h > 0.0f ? (local_y / line_h)
+                                                       : 0.0f)));
+
+            auto s = binding_get(binding);
+            struct Line {
+              std::int64_t start{};
+              std::int64_t len{};
+            };
+            std::vector<Line> lines;
+            lines.reserve(8);
+            {
+              std::int64_t start = 0;
+              std::int64_t cur = 0;
+              for (std::size_t i = 0; i < s.size();) {
+                if (s[i] == '\n') {
                   lines.push_back(Line{start, cur - start});
+                  ++cur;
+                  ++i;
+                  start = cur;
+                  continue;
+                }
+                const auto b0 = static_cast<std::uint8_t>(s[i]);
+                std::size_t adv = 1;
+                if ((b0 & 0x80) == 0x00) {
+                  adv = 1;
+                } else if ((b0 & 0xE0) == 0xC0) {
+                  adv = 2;
+                } else if ((b0 & 0xF0) == 0xE0) {
+                  adv = 3;
+                } else if ((b0 & 0xF8) == 0xF0) {
+                  adv = 4;
+                }
+                if (i + adv > s.size()) {
+                  adv = 1;
                 }
+                i += adv;
+                ++cur;
+              }
+              lines.push_back(Line{start, cur - start});
+            }
 
-                const auto total_len = utf8_count(s);
-                const auto rrow = std::max<std::int64_t>(
-                    0, std::min<std::int64_t>(row,
-                                              static_cast<std::int64_t>(lines.size()) -
-                                                  1));
-                const auto line_start = lines[static_cast<std::size_t>(rrow)].start;
-                const auto line_len = lines[static_cast<std::size_t>(rrow)].len;
-                const auto next = line_start + std::min(col, line_len);
-                const auto pos =
-                    std::max<std::int64_t>(0, std::min(next, total_len));
-                caret.set(pos);
-                sel_anchor.set(pos);
-                sel_end.set(pos);
-                capture_pointer();
-              }));
+            const auto total_len = utf8_count(s);
+            const auto rrow = std::max<std::int64_t>(
+                0, std::min<std::int64_t>(row,
+                                          static_cast<std::int64_t>(lines.size()) -
+                                              1));
+            const auto line_start = lines[static_cast<std::size_t>(rrow)].start;
+            const auto line_len = lines[static_cast<std::size_t>(rrow)].len;
+            const auto next = line_start + std::min(col, line_len);
+            const auto pos =
+                std::max<std::int64_t>(0, std::min(next, total_len));
+            caret.set(pos);
+            sel_anchor.set(pos);
+            sel_end.set(pos);
+            capture_pointer();
+          });
         }
       }
 
-      if (auto it = node.events.find("pointer_move");
-          it == node.events.end() || it->second == 0) {
+      if (!node.events.has(EventKind::PointerMove)) {
         if (node.type == "TextField") {
-          node.events.insert_or_assign(
-              "pointer_move",
-              event_collector.add([caret, sel_end, binding, padding,
-                                   font_px]() mutable {
-                auto r = target_frame();
-                if (!r) {
-                  return;
+          bind_event(EventKind::PointerMove, [caret, sel_end, binding, padding,
+                                              font_px]() mutable {
+            auto r = target_frame();
+            if (!r) {
+              return;
+            }
+            const float char_w = font_px * 0.5f;
+            const float local_x = pointer_x() - (r->x + padding);
+            const auto len = utf8_count(binding_get(binding));
+            auto pos = static_cast<std::int64_t>(
+                std::round(char_w > 0.0f ? (local_x / char_w) : 0.0f));
+            pos = std::max<std::int64_t>(0, std::min(pos, len));
+            caret.set(pos);
+            sel_end.set(pos);
+          });
+        } else {
+          bind_event(EventKind::PointerMove, [caret, sel_end, binding, padding,
+                                              font_px]() mutable {
+            auto r = target_frame();
+            if (!r) {
+              return;
+            }
+            const float char_w = font_px * 0.5f;
+            const float line_h = font_px * 1.2f;
+
+            const float local_x = pointer_x() - (r->x + padding);
+            const float local_y = pointer_y() - (r->y + padding);
+            const std::int64_t col = static_cast<std::int64_t>(
+                std::max(0.0f, std::round(char_w > 0.0f ? (local_x / char_w)
+                                                       : 0.0f)));
+            const std::int64_t row = static_cast<std::int64_t>(
+                std::max(0.0f, std::floor(line_h > 0.0f ? (local_y / line_h)
+                                                       : 0.0f)));
+
+            auto s = binding_get(binding);
+            struct Line {
+              std::int64_t start{};
+              std::int64_t len{};
+            };
+            std::vector<Line> lines;
+            lines.reserve(8);
+            {
+              std::int64_t start = 0;
+              std::int64_t cur = 0;
+              for (std::size_t i = 0; i < s.size();) {
+                if (s[i] == '\n') {
+                  lines.push_back(Line{start, cur - start});
+                  ++cur;
+                  ++i;
+                  start = cur;
+                  continue;
                 }
-                const float char_w = font_px * 0.5f;
-                const float local_x = pointer_x() - (r->x + padding);
-                const auto len = utf8_count(binding_get(binding));
-                auto pos = static_cast<std::int64_t>(
-                    std::round(char_w > 0.0f ? (local_x / char_w) : 0.0f));
-                pos = std::max<std::int64_t>(0, std::min(pos, len));
-                caret.set(pos);
-                sel_end.set(pos);
-              }));
-        } else {
-          node.events.insert_or_assign(
-              "pointer_move",
-              event_collector.add([caret, sel_end, binding, padding,
-                                   font_px]() mutable {
-                auto r = target_frame();
-                if (!r) {
-                  return;
+                const auto b0 = static_cast<std::uint8_t>(s[i]);
+                std::size_t adv = 1;
+                if ((b0 & 0x80) == 0x00) {
+                  adv = 1;
+                } else if ((b0 & 0xE0) == 0xC0) {
+                  adv = 2;
+                } else if ((b0 & 0xF0) == 0xE0) {
+                  adv = 3;
+                } else if ((b0 & 0xF8) == 0xF0) {
+                  adv = 4;
                 }
-                const float char_w = font_px * 0.5f;
-                const float line_h = font_px * 1.2f;
-
-                const float local_x = pointer_x() - (r->x + padding);
-                const float local_y = pointer_y() - (r->y + padding);
-                const std::int64_t col = static_cast<std::int64_t>(
-                    std::max(0.0f, std::round(char_w > 0.0f ? (local_x / char_w)
-                                                           : 0.0f)));
-                const std::int64_t row = static_cast<std::int64_t>(
-                    std::max(0.0f, std::floor(line_h > 0.0f ? (local_y / line_h)
-                                                           : 0.0f)));
-
-                auto s = binding_get(binding);
-                struct Line {
-                  std::int64_t start{};
-                  std::int64_t len{};
-                };
-                std::vector<Line> lines;
-                lines.reserve(8);
-                {
-                  std::int64_t start = 0;
-                  std::int64_t cur = 0;
-                  for (std::size_t i = 0; i < s.size();) {
-                    if (s[i] == '\n') {
-                      lines.push_back(Line{start, cur - start});
-                      ++cur;
-                      ++i;
-                      start = cur;
-                      continue;
-                    }
-                    const auto b0 = static_cast<std::uint8_t>(s[i]);
-                    std::size_t adv = 1;
-                    if ((b0 & 0x80) == 0x00) {
-                      adv = 1;
-                    } else if ((b0 & 0xE0) == 0xC0) {
-                      adv = 2;
-                    } else if ((b0 & 0xF0) == 0xE0) {
-                      adv = 3;
-                    } else if ((b0 & 0xF8) == 0xF0) {
-                      adv = 4;
-                    }
-                    if (i + adv > s.size()) {
-                      adv = 1;
-                    }
-                    i += adv;
-                    ++cur;
-                  }
-                  lines.push_back(Line{start, cur - start});
+                if (i + adv > s.size()) {
+                  adv = 1;
                 }
+                i += adv;
+                ++cur;
+              }
+              lines.push_back(Line{start, cur - start});
+            }
 
-                const auto total_len = utf8_count(s);
-                const auto rrow = std::max<std::int64_t>(
-                    0, std::min<std::int64_t>(row,
-                                              static_cast<std::int64_t>(lines.size()) -
-                                                  1));
-                const auto line_start = lines[static_cast<std::size_t>(rrow)].start;
-                const auto line_len = lines[static_cast<std::size_t>(rrow)].len;
-                const auto next = line_start + std::min(col, line_len);
-                const auto pos =
-                    std::max<std::int64_t>(0, std::min(next, total_len));
-                caret.set(pos);
-                sel_end.set(pos);
-              }));
+            const auto total_len = utf8_count(s);
+            const auto rrow = std::max<std::int64_t>(
+                0, std::min<std::int64_t>(row,
+                                          static_cast<std::int64_t>(lines.size()) -
+                                              1));
+            const auto line_start = lines[static_cast<std::size_t>(rrow)].start;
+            const auto line_len = lines[static_cast<std::size_t>(rrow)].len;
+            const auto next = line_start + std::min(col, line_len);
+            const auto pos =
+                std::max<std::int64_t>(0, std::min(next, total_len));
+            caret.set(pos);
+            sel_end.set(pos);
+          });
         }
       }
 
-      if (auto it = node.events.find("pointer_up");
-          it == node.events.end() || it->second == 0) {
-        node.events.insert_or_assign(
-            "pointer_up", event_collector.add([]() mutable { release_pointer(); }));
+      if (!node.events.has(EventKind::PointerUp)) {
+        bind_event(EventKind::PointerUp, []() mutable { release_pointer(); });
       }
 
-      if (auto it = node.events.find("key_down");
-          it == node.events.end() || it->second == 0) {
+      if (!node.events.has(EventKind::KeyDown)) {
         if (node.type == "TextField") {
-          node.events.insert_or_assign(
-              "key_down",
-              event_collector.add([binding, caret, sel_anchor, sel_end]() mutable {
-                auto c = caret.get();
-                auto a = sel_anchor.get();
-                auto b = sel_end.get();
-                auto s = binding_get(binding);
-                const auto len = utf8_count(s);
-                c = std::max<std::int64_t>(0, std::min(c, len));
-                a = std::max<std::int64_t>(0, std::min(a, len));
-                b = std::max<std::int64_t>(0, std::min(b, len));
-
-                if (key_code() == KEY_LEFT) {
-                  c = std::max<std::int64_t>(0, c - 1);
-                } else if (key_code() == KEY_RIGHT) {
-                  c = std::min<std::int64_t>(len, c + 1);
-                } else if (key_code() == KEY_HOME) {
-                  c = 0;
-                } else if (key_code() == KEY_END) {
-                  c = len;
-                } else if (key_code() == KEY_BACKSPACE) {
-                  if (a != b) {
-                    if (utf8_erase_range(s, c, a, b)) {
-                      binding_set(binding, std::move(s));
-                      a = c;
-                      b = c;
-                    }
-                  } else {
-                    utf8_erase_prev_char(s, c);
-                    binding_set(binding, std::move(s));
-                  }
-                } else if (key_code() == KEY_DELETE) {
-                  if (a != b) {
-                    if (utf8_erase_range(s, c, a, b)) {
-                      binding_set(binding, std::move(s));
-                      a = c;
-                      b = c;
-                    }
-                  } else {
-                    utf8_erase_at_char(s, c);
-                    binding_set(binding, std::move(s));
-                  }
+          bind_event(EventKind::KeyDown,
+                     [binding, caret, sel_anchor, sel_end]() mutable {
+            auto c = caret.get();
+            auto a = sel_anchor.get();
+            auto b = sel_end.get();
+            auto s = binding_get(binding);
+            const auto len = utf8_count(s);
+            c = std::max<std::int64_t>(0, std::min(c, len));
+            a = std::max<std::int64_t>(0, std::min(a, len));
+            b = std::max<std::int64_t>(0, std::min(b, len));
+
+            if (key_code() == KEY_LEFT) {
+              c = std::max<std::int64_t>(0, c - 1);
+            } else if (key_code() == KEY_RIGHT) {
+              c = std::min<std::int64_t>(len, c + 1);
+            } else if (key_code() == KEY_HOME) {
+              c = 0;
+            } else if (key_code() == KEY_END) {
+              c = len;
+            } else if (key_code() == KEY_BACKSPACE) {
+              if (a != b) {
+                if (utf8_erase_range(s, c, a, b)) {
+                  binding_set(binding, std::move(s));
+                  a = c;
+                  b = c;
+                }
+              } else {
+                utf8_erase_prev_char(s, c);
+                binding_set(binding, std::move(s));
+              }
+            } else if (key_code() == KEY_DELETE) {
+              if (a != b) {
+                if (utf8_erase_range(s, c, a, b)) {
+                  binding_set(binding, std::move(s));
+                  a = c;
+                  b = c;
                 }
+              } else {
+                utf8_erase_at_char(s, c);
+                binding_set(binding, std::move(s));
+              }
+            }
 
-                caret.set(c);
-                sel_anchor.set(c);
-                sel_end.set(c);
-              }));
+            caret.set(c);
+            sel_anchor.set(c);
+            sel_end.set(c);
+          });
         } else {
-          node.events.insert_or_assign(
-              "key_down",
-              event_collector.add([binding, caret, sel_anchor, sel_end]() mutable {
-                auto c = caret.get();
-                auto a = sel_anchor.get();
-                auto b = sel_end.get();
-                auto s = binding_get(binding);
-                const auto total_len = utf8_count(s);
-                c = std::max<std::int64_t>(0, std::min(c, total_len));
-                a = std::max<std::int64_t>(0, std::min(a, total_len));
-                b = std::max<std::int64_t>(0, std::min(b, total_len));
-
-                struct Line {
-                  std::int64_t start{};
-                  std::int64_t len{};
-                };
-                std::vector<Line> lines;
-                lines.reserve(8);
-                {
-                  std::int64_t start = 0;
-                  std::int64_t cur = 0;
-                  for (std::size_t i = 0; i < s.size();) {
-                    if (s[i] == '\n') {
-                      lines.push_back(Line{start, cur - start});
-                      ++cur;
-                      ++i;
-                      start = cur;
-                      continue;
-                    }
-                    const auto b0 = static_cast<std::uint8_t>(s[i]);
-                    std::size_t adv = 1;
-                    if ((b0 & 0x80) == 0x00) {
-                      adv = 1;
-                    } else if ((b0 & 0xE0) == 0xC0) {
-                      adv = 2;
-                    } else if ((b0 & 0xF0) == 0xE0) {
-                      adv = 3;
-                    } else if ((b0 & 0xF8) == 0xF0) {
-                      adv = 4;
-                    }
-                    if (i + adv > s.size()) {
-                      adv = 1;
-                    }
-                    i += adv;
-                    ++cur;
-                  }
+          bind_event(EventKind::KeyDown,
+                     [binding, caret, sel_anchor, sel_end]() mutable {
+            auto c = caret.get();
+            auto a = sel_anchor.get();
+            auto b = sel_end.get();
+            auto s = binding_get(binding);
+            const auto total_len = utf8_count(s);
+            c = std::max<std::int64_t>(0, std::min(c, total_len));
+            a = std::max<std::int64_t>(0, std::min(a, total_len));
+            b = std::max<std::int64_t>(0, std::min(b, total_len));
+
+            struct Line {
+              std::int64_t start{};
+              std::int64_t len{};
+            };
+            std::vector<Line> lines;
+            lines.reserve(8);
+            {
+              std::int64_t start = 0;
+              std::int64_t cur = 0;
+              for (std::size_t i = 0; i < s.size();) {
+                if (s[i] == '\n') {
                   lines.push_back(Line{start, cur - start});
+                  ++cur;
+                  ++i;
+                  start = cur;
+                  continue;
                 }
-
-                std::size_t line_idx = 0;
-                for (std::size_t i = 0; i < lines.size(); ++i) {
-                  if (c <= lines[i].start + lines[i].len) {
-                    line_idx = i;
-                    break;
-                  }
+                const auto b0 = static_cast<std::uint8_t>(s[i]);
+                std::size_t adv = 1;
+                if ((b0 & 0x80) == 0x00) {
+                  adv = 1;
+                } else if ((b0 & 0xE0) == 0xC0) {
+                  adv = 2;
+                } else if ((b0 & 0xF0) == 0xE0) {
+                  adv = 3;
+                } else if ((b0 & 0xF8) == 0xF0) {
+                  adv = 4;
                 }
-                const std::int64_t col = c - lines[line_idx].start;
-
-                if (key_code() == KEY_LEFT) {
-                  c = std::max<std::int64_t>(0, c - 1);
-                } else if (key_code() == KEY_RIGHT) {
-                  c = std::min<std::int64_t>(total_len, c + 1);
-                } else if (key_code() == KEY_HOME) {
-                  c = lines[line_idx].start;
-                } else if (key_code() == KEY_END) {
-                  c = lines[line_idx].start + lines[line_idx].len;
-                } else if (key_code() == KEY_UP) {
-                  if (line_idx > 0) {
-                    const auto prev = lines[line_idx - 1];
-                    c = prev.start + std::min(col, prev.len);
-                  }
-                } else if (key_code() == KEY_DOWN) {
-                  if (line_idx + 1 < lines.size()) {
-                    const auto next = lines[line_idx + 1];
-                    c = next.start + std::min(col, next.len);
-                  }
-                } else if (key_code() == KEY_BACKSPACE) {
-                  if (a != b) {
-                    if (utf8_erase_range(s, c, a, b)) {
-                      binding_set(binding, std::move(s));
-                      a = c;
-                      b = c;
-                    }
-                  } else {
-                    utf8_erase_prev_char(s, c);
-                    binding_set(binding, std::move(s));
-                  }
-                } else if (key_code() == KEY_DELETE) {
-                  if (a != b) {
-                    if (utf8_erase_range(s, c, a, b)) {
-                      binding_set(binding, std::move(s));
-                      a = c;
-                      b = c;
-                    }
-                  } else {
-                    utf8_erase_at_char(s, c);
-                    binding_set(binding, std::move(s));
-                  }
-                } else if (key_code() == KEY_ENTER || key_code() == KEY_KP_ENTER) {
-                  if (a != b) {
-                    if (utf8_erase_range(s, c, a, b)) {
-                      a = c;
-                      b = c;
-                    }
-                  }
-                  utf8_insert_at_char(s, c, "\n");
-                  binding_set(binding, std::move(s));
+                if (i + adv > s.size()) {
+                  adv = 1;
                 }
+                i += adv;
+                ++cur;
+              }
+              lines.push_back(Line{start, cur - start});
+            }
 
-                caret.set(c);
-                sel_anchor.set(c);
-                sel_end.set(c);
-              }));
-        }
-      }
+            std::size_t line_idx = 0;
+            for (std::size_t i = 0; i < lines.size(); ++i) {
+              if (c <= lines[i].start + lines[i].len) {
+                line_idx = i;
+                break;
+              }
+            }
+            const std::int64_t col = c - lines[line_idx].start;
 
-      if (auto it = node.events.find("text_input");
-          it == node.events.end() || it->second == 0) {
-        node.events.insert_or_assign(
-            "text_input",
-            event_collector.add([binding, caret, sel_anchor, sel_end]() mutable {
-              auto c = caret.get();
-              auto a = sel_anchor.get();
-              auto b = sel_end.get();
-              auto s = binding_get(binding);
+            if (key_code() == KEY_LEFT) {
+              c = std::max<std::int64_t>(0, c - 1);
+            } else if (key_code() == KEY_RIGHT) {
+              c = std::min<std::int64_t>(total_len, c + 1);
+            } else if (key_code() == KEY_HOME) {
+              c = lines[line_idx].start;
+            } else if (key_code() == KEY_END) {
+              c = lines[line_idx].start + lines[line_idx].len;
+            } else if (key_code() == KEY_UP) {
+              if (line_idx > 0) {
+                const auto prev = lines[line_idx - 1];
+                c = prev.start + std::min(col, prev.len);
+              }
+            } else if (key_code() == KEY_DOWN) {
+              if (line_idx + 1 < lines.size()) {
+                const auto next = lines[line_idx + 1];
+                c = next.start + std::min(col, next.len);
+              }
+            } else if (key_code() == KEY_BACKSPACE) {
+              if (a != b) {
+                if (utf8_erase_range(s, c, a, b)) {
+                  binding_set(binding, std::move(s));
+                  a = c;
+                  b = c;
+                }
+              } else {
+                utf8_erase_prev_char(s, c);
+                binding_set(binding, std::move(s));
+              }
+            } else if (key_code() == KEY_DELETE) {
+              if (a != b) {
+                if (utf8_erase_range(s, c, a, b)) {
+                  binding_set(binding, std::move(s));
+                  a = c;
+                  b = c;
+                }
+              } else {
+                utf8_erase_at_char(s, c);
+                binding_set(binding, std::move(s));
+              }
+            } else if (key_code() == KEY_ENTER || key_code() == KEY_KP_ENTER) {
               if (a != b) {
                 if (utf8_erase_range(s, c, a, b)) {
                   a = c;
                   b = c;
                 }
               }
-              utf8_insert_at_char(s, c, text_input());
+              utf8_insert_at_char(s, c, "\n");
               binding_set(binding, std::move(s));
-              caret.set(c);
-              sel_anchor.set(c);
-              sel_end.set(c);
-            }));
+            }
+
+            caret.set(c);
+            sel_anchor.set(c);
+            sel_end.set(c);
+          });
+        }
+      }
+
+      if (!node.events.has(EventKind::TextInput)) {
+        bind_event(EventKind::TextInput,
+                   [binding, caret, sel_anchor, sel_end]() mutable {
+          auto c = caret.get();
+          auto a = sel_anchor.get();
+          auto b = sel_end.get();
+          auto s = binding_get(binding);
+          if (a != b) {
+            if (utf8_erase_range(s, c, a, b)) {
+              a = c;
+              b = c;
+            }
+          }
+          utf8_insert_at_char(s, c, text_input());
+          binding_set(binding, std::move(s));
+          caret.set(c);
+          sel_anchor.set(c);
+          sel_end.set(c);
+        });
       }
     };
 
-    apply_text_bindings(apply_text_bindings, new_tree);
     new_tree = normalize_root(flatten_groups(std::move(new_tree)));
+    assign_stable_ids(new_tree);
     restore_scroll_offsets(new_tree);
 
+    auto has_geometry_reader = [](auto &&self, const ViewNode &node) -> bool {
+      if (node.type == "GeometryReader") {
+        return true;
+      }
+      for (const auto &ch : node.children) {
+        if (self(self, ch)) {
+          return true;
+        }
+      }
+      return false;
+    };
+
+    auto seed_bound_values = [&](auto &&self, ViewNode &node) -> void {
+      for (auto &ch : node.children) {
+        self(self, ch);
+      }
+      if (node.type != "TextField" && node.type != "TextEditor") {
+        return;
+      }
+      auto binding_raw = prop_as_i64_opt(node.props, "binding");
+      if (!binding_raw) {
+        binding_raw = prop_as_i64_opt(node.props, "value");
+      }
+      if (binding_raw && *binding_raw != 0) {
+        node.props.insert_or_assign(
+            "value", PropValue{binding_get(BindingId{*binding_raw})});
+      }
+    };
+
     auto resolve_geometry_readers = [&](ViewNode &root) {
       for (int iter = 0; iter < 4; ++iter) {
         const auto layout0 = layout_tree(root, viewport_);
@@ -3479,10 +4519,13 @@ private:
       }
     };
 
-    resolve_geometry_readers(new_tree);
-
-    new_tree = normalize_root(flatten_groups(std::move(new_tree)));
-    restore_scroll_offsets(new_tree);
+    if (has_geometry_reader(has_geometry_reader, new_tree)) {
+      seed_bound_values(seed_bound_values, new_tree);
+      resolve_geometry_readers(new_tree);
+      new_tree = normalize_root(flatten_groups(std::move(new_tree)));
+      assign_stable_ids(new_tree);
+      restore_scroll_offsets(new_tree);
+    }
     apply_text_bindings(apply_text_bindings, new_tree);
 
     if (auto obj = env_object("style.manager")) {
@@ -3526,6 +4569,7 @@ private:
       a.start_ms = anim_start_ms;
       a.duration_ms = spec.duration_ms;
       a.delay_ms = spec.delay_ms;
+      a.curve = animation_curve_from_name(spec.curve);
       next_anims.push_back(std::move(a));
     };
 
@@ -3577,13 +4621,43 @@ private:
           p);
     }
 
-    anims_ = std::move(next_anims);
     tree_ = std::move(new_tree);
 
+    if (old_tree.type.empty()) {
+      render_cache_.clear();
+    }
+    for (const auto &p : patches) {
+      std::visit(
+          [&](const auto &op) {
+            using T = std::decay_t<decltype(op)>;
+            if constexpr (std::is_same_v<T, PatchInsertChild> ||
+                          std::is_same_v<T, PatchRemoveChild>) {
+              render_cache_.invalidate(tree_, op.parent_path);
+            } else {
+              render_cache_.invalidate(tree_, op.path);
+            }
+          },
+          p);
+    }
+
+    if (old_tree.type.empty()) {
+      key_index_.rebuild(tree_);
+    } else {
+      key_index_.apply(tree_, patches);
+    }
+    report_duplicate_keys();
+
+    spare_handlers_ = std::move(handlers_);
+    spare_handlers_.clear();
     handlers_ = std::move(event_collector.handlers);
+    stable_handlers_ = std::move(event_collector.stable);
+    handlers_reused_ = event_collector.reused;
+    event_mask_ = collect_event_mask(tree_);
 
+    layout_flushed_ = false;
     const bool layout_rebuilt =
-        old_tree.type.empty() || patches_affect_layout(patches);
+        std::exchange(layout_pending_, false) || old_tree.type.empty() ||
+        patches_affect_layout(patches);
     if (layout_rebuilt) {
       layout_ = layout_tree(tree_, viewport_);
     } else {
@@ -3638,6 +4712,7 @@ private:
                 const double from_y = base_y + dy;
                 v.props.insert_or_assign("render_offset_x", PropValue{from_x});
                 v.props.insert_or_assign("render_offset_y", PropValue{from_y});
+                render_cache_.invalidate(tree_, path);
 
                 PropAnim ax;
                 ax.path = path;
@@ -3647,7 +4722,8 @@ private:
                 ax.start_ms = anim_start_ms;
                 ax.duration_ms = s->duration_ms;
                 ax.delay_ms = s->delay_ms;
-                anims_.push_back(std::move(ax));
+                ax.curve = animation_curve_from_name(s->curve);
+                next_anims.push_back(std::move(ax));
 
                 PropAnim ay;
                 ay.path = path;
@@ -3657,7 +4733,8 @@ private:
                 ay.start_ms = anim_start_ms;
                 ay.duration_ms = s->duration_ms;
                 ay.delay_ms = s->delay_ms;
-                anims_.push_back(std::move(ay));
+                ay.curve = animation_curve_from_name(s->curve);
+                next_anims.push_back(std::move(ay));
               }
             }
           }
@@ -3677,17 +4754,15 @@ private:
       }
     }
 
-    render_ops_ = build_render_ops(tree_, layout_);
+    start_animations(std::move(next_anims));
+    rebuild_render_ops();
 
-    deps_.clear();
-    deps_.reserve(collector.states.size());
-    for (auto *s : collector.states) {
-      DepEntry entry;
-      entry.state = s;
-      entry.version = s->version();
-      entry.sub = s->subscribe([this]() { dirty_ = true; });
-      deps_.push_back(std::move(entry));
-    }
+    collector.finish();
+    update_dependencies(collector.states);
+    dep_collect_ = std::move(collector.states);
+
+    sweep_tasks();
+    sweep_local_states();
 
     dirty_ = false;
     return UpdateResult{true, std::move(patches), layout_rebuilt, true};
@@ -3697,25 +4772,51 @@ private:
   ViewNode tree_{};
   LayoutNode layout_{};
   std::vector<RenderOp> render_ops_{};
+  RenderOpCache render_cache_{};
+  NodeKeyIndex key_index_{};
+  std::unordered_set<std::string> reported_duplicates_{};
+  std::function<void(const std::string &)> diagnostic_handler_{};
   SizeF viewport_{800.0f, 600.0f};
-  std::vector<DepEntry> deps_{};
-  std::unordered_map<std::uint64_t, std::function<void()>> handlers_{};
+  std::vector<StateBase *> dep_states_{};
+  std::vector<std::uint64_t> dep_versions_{};
+  std::vector<Subscription> dep_subs_{};
+  std::vector<StateBase *> dep_scratch_states_{};
+  std::vector<std::uint64_t> dep_scratch_versions_{};
+  std::vector<Subscription> dep_scratch_subs_{};
+  std::vector<StateBase *> dep_collect_{};
+  DependencyStats dep_stats_{};
+  std::vector<EventHandler> handlers_{};
+  std::vector<EventHandler> spare_handlers_{};
+  std::unordered_map<std::uint64_t, detail::EventCollector::Stable>
+      stable_handlers_{};
+  std::size_t handlers_reused_{};
+  std::uint16_t event_mask_{};
+  bool layout_pending_{};
+  bool layout_flushed_{};
   std::unordered_map<int, CaptureTarget> captures_{};
   std::unordered_set<int> pointers_down_{};
+  std::unordered_map<int, PointerVelocity> pointer_velocity_{};
   std::unordered_map<std::string, double> scroll_offsets_x_{};
   std::unordered_map<std::string, double> scroll_offsets_{};
   std::unordered_map<int, ScrollDrag> scroll_drags_{};
   std::optional<FocusTarget> focus_{};
-  std::unordered_map<std::string, std::shared_ptr<StateBase>> local_states_{};
+  detail::LocalStateTable local_states_{};
+  LocalStateRetention retention_{};
+  LocalStateStats local_stats_{};
   std::unordered_map<std::string, PropValue> env_values_{};
   std::unordered_map<std::string, std::shared_ptr<void>> env_objects_{};
   std::string style_toml_cache_{};
-  std::vector<detail::StyleRule> style_rules_cache_{};
+  detail::StyleIndex style_index_{};
   std::optional<AnimationSpec> pending_animation_{};
-  std::vector<PropAnim> anims_{};
+  AnimationEngine anims_{};
+  std::vector<AnimTarget> anim_targets_{};
+  std::uint64_t anim_stamp_{};
+  std::vector<RenderTransform> render_transforms_{RenderTransform{}};
   std::unordered_map<std::string, TimelineReg> timelines_{};
   std::unordered_map<std::string, FileWatchReg> file_watches_{};
-  bool dirty_{true};
+  std::unordered_map<std::string, TaskReg> tasks_{};
+  std::uint64_t build_count_{};
+  std::atomic<bool> dirty_{true};
 };
 
 namespace detail {
@@ -3734,9 +4835,9 @@ inline void request_animation(const AnimationSpec &spec) {
 }
 } // namespace detail
 
-template <typename T> StateHandle<T> local_state(std::string key, T initial) {
+template <typename T> StateHandle<T> local_state(StateKey key, T initial) {
   if (detail::active_build_instance) {
-    return detail::active_build_instance->local_state<T>(std::move(key),
+    return detail::active_build_instance->local_state<T>(key,
                                                          std::move(initial));
   }
   return state<T>(std::move(initial));
@@ -3778,8 +4879,7 @@ inline ObservedObjectHandle<T> ObservedObject(std::shared_ptr<T> obj) {
 template <typename T, typename... Args>
 inline ObservedObjectHandle<T> StateObject(std::string key, Args &&...args) {
   static_assert(std::is_base_of_v<StateBase, T>);
-  auto slot = local_state<std::shared_ptr<T>>(std::move(key),
-                                              std::shared_ptr<T>{});
+  auto slot = local_state<std::shared_ptr<T>>(key, std::shared_ptr<T>{});
   auto obj = slot.get();
   if (!obj) {
     obj = std::make_shared<T>(std::forward<Args>(args)...);
@@ -3792,6 +4892,27 @@ template <typename T> inline StateHandle<T> FocusState(std::string key, T initia
   return local_state<T>(std::move(key), std::move(initial));
 }
 
+template <typename F> inline auto use_async(std::string key, F fn) {
+  using R = std::decay_t<
+      decltype(detail::invoke_task(std::declval<F &>(), CancelToken{}))>;
+  if (!detail::active_build_instance) {
+    return std::optional<R>{};
+  }
+  return detail::active_build_instance
+      ->start_task(std::move(key), std::move(fn))
+      .get();
+}
+
+template <typename F, typename ContentFn>
+inline ViewNode Task(std::string key, F fn, ContentFn content,
+                     ViewNode placeholder) {
+  auto result = use_async(std::move(key), std::move(fn));
+  if (!result) {
+    return placeholder;
+  }
+  return content(std::move(*result));
+}
+
 inline void provide_environment(std::string key, PropValue value) {
   if (!detail::active_build_instance) {
     return;
@@ -3976,28 +5097,18 @@ inline ViewNode focusable(ViewNode node, StateHandle<std::string> focus,
   }
   const std::string focus_id = node.key.empty() ? std::move(id) : node.key;
 
-  const auto prev_focus = [&]() -> std::uint64_t {
-    if (const auto it = node.events.find("focus"); it != node.events.end()) {
-      return it->second;
-    }
-    return 0;
-  }();
-  const auto prev_blur = [&]() -> std::uint64_t {
-    if (const auto it = node.events.find("blur"); it != node.events.end()) {
-      return it->second;
-    }
-    return 0;
-  }();
+  const auto prev_focus = node.events.get(EventKind::Focus);
+  const auto prev_blur = node.events.get(EventKind::Blur);
 
   node.props.insert_or_assign("focused", focus.get() == focus_id);
 
-  node.events.insert_or_assign(
-      "focus", chain_handler(prev_focus, [focus, focus_id]() mutable {
+  node.events.set(
+      EventKind::Focus, chain_handler(prev_focus, [focus, focus_id]() mutable {
         focus.set(focus_id);
       }));
 
-  node.events.insert_or_assign(
-      "blur", chain_handler(prev_blur, [focus, focus_id]() mutable {
+  node.events.set(
+      EventKind::Blur, chain_handler(prev_blur, [focus, focus_id]() mutable {
         if (focus.get() == focus_id) {
           focus.set("");
         }
@@ -4232,7 +5343,7 @@ inline ViewNode TimelineView(std::string key, double interval_ms, ContentFn fn)
   if (detail::active_build_instance) {
     detail::active_build_instance->register_timeline(key, interval_ms);
   }
-  auto now = local_state<double>(key + ":timeline_now", now_ms());
+  auto now = local_state<double>(StateKey{key}.with(":timeline_now"), now_ms());
   return fn(now.get());
 }
 
@@ -4253,6 +5364,11 @@ inline ViewNode matchedGeometryEffect(ViewNode node, std::string ns, std::string
   return node;
 }
 
+inline ViewNode drawingGroup(ViewNode node, bool enabled = true) {
+  node.props.insert_or_assign("drawing_group", PropValue{enabled});
+  return node;
+}
+
 inline ViewNode Transition(ViewNode node, std::string type = "opacity") {
   node.props.insert_or_assign("transition", PropValue{std::move(type)});
   return node;
@@ -4286,15 +5402,9 @@ inline std::uint64_t chain_handler(std::uint64_t prev_handler_id, Fn fn) {
 }
 
 inline ViewNode onTapGesture(ViewNode node, std::function<void()> fn) {
-  const auto prev = [&]() -> std::uint64_t {
-    if (const auto it = node.events.find("pointer_up");
-        it != node.events.end()) {
-      return it->second;
-    }
-    return 0;
-  }();
-  node.events.insert_or_assign(
-      "pointer_up",
+  const auto prev = node.events.get(EventKind::PointerUp);
+  node.events.set(
+      EventKind::PointerUp,
       chain_handler(prev, [fn = std::move(fn)]() mutable {
         if (fn) {
           fn();
@@ -4310,6 +5420,8 @@ struct DragGestureValue {
   float y{};
   float dx{};
   float dy{};
+  float velocity_x{};
+  float velocity_y{};
 };
 
 inline ViewNode DragGesture(ViewNode node, std::string key,
@@ -4321,35 +5433,18 @@ inline ViewNode DragGesture(ViewNode node, std::string key,
   }
   const std::string state_key = node.key.empty() ? std::move(key) : node.key;
 
-  auto active = local_state<bool>(state_key + ":drag:active", false);
-  auto started = local_state<bool>(state_key + ":drag:started", false);
-  auto start_x = local_state<double>(state_key + ":drag:start_x", 0.0);
-  auto start_y = local_state<double>(state_key + ":drag:start_y", 0.0);
+  const StateKey slot_key{state_key};
+  auto active = local_state<bool>(slot_key.with(":drag:active"), false);
+  auto started = local_state<bool>(slot_key.with(":drag:started"), false);
+  auto start_x = local_state<double>(slot_key.with(":drag:start_x"), 0.0);
+  auto start_y = local_state<double>(slot_key.with(":drag:start_y"), 0.0);
 
-  const auto prev_down = [&]() -> std::uint64_t {
-    if (const auto it = node.events.find("pointer_down");
-        it != node.events.end()) {
-      return it->second;
-    }
-    return 0;
-  }();
-  const auto prev_move = [&]() -> std::uint64_t {
-    if (const auto it = node.events.find("pointer_move");
-        it != node.events.end()) {
-      return it->second;
-    }
-    return 0;
-  }();
-  const auto prev_up = [&]() -> std::uint64_t {
-    if (const auto it = node.events.find("pointer_up");
-        it != node.events.end()) {
-      return it->second;
-    }
-    return 0;
-  }();
+  const auto prev_down = node.events.get(EventKind::PointerDown);
+  const auto prev_move = node.events.get(EventKind::PointerMove);
+  const auto prev_up = node.events.get(EventKind::PointerUp);
 
-  node.events.insert_or_assign(
-      "pointer_down",
+  node.events.set(
+      EventKind::PointerDown,
       chain_handler(prev_down, [active, started, start_x, start_y]() mutable {
         active.set(true);
         started.set(false);
@@ -4358,8 +5453,8 @@ inline ViewNode DragGesture(ViewNode node, std::string key,
         capture_pointer();
       }));
 
-  node.events.insert_or_assign(
-      "pointer_move",
+  node.events.set(
+      EventKind::PointerMove,
       chain_handler(prev_move, [active, started, start_x, start_y, min_distance,
                                on_changed]() mutable {
         if (!active.get()) {
@@ -4380,12 +5475,13 @@ inline ViewNode DragGesture(ViewNode node, std::string key,
         }
 
         if (on_changed) {
-          on_changed(DragGestureValue{sx, sy, x, y, dx, dy});
+          on_changed(DragGestureValue{
+              sx, sy, x, y, dx, dy, pointer_velocity_x(), pointer_velocity_y()});
         }
       }));
 
-  node.events.insert_or_assign(
-      "pointer_up",
+  node.events.set(
+      EventKind::PointerUp,
       chain_handler(prev_up, [active, started, start_x, start_y, on_ended]() mutable {
         if (!active.get()) {
           return;
@@ -4398,7 +5494,8 @@ inline ViewNode DragGesture(ViewNode node, std::string key,
         const float dx = x - sx;
         const float dy = y - sy;
         if (started.get() && on_ended) {
-          on_ended(DragGestureValue{sx, sy, x, y, dx, dy});
+          on_ended(DragGestureValue{
+              sx, sy, x, y, dx, dy, pointer_velocity_x(), pointer_velocity_y()});
         }
         started.set(false);
         release_pointer();
@@ -4416,35 +5513,18 @@ inline ViewNode onLongPressGesture(ViewNode node, std::string key,
   }
   const std::string state_key = node.key.empty() ? std::move(key) : node.key;
 
-  auto pressed = local_state<bool>(state_key + ":lp:pressed", false);
-  auto start_t = local_state<double>(state_key + ":lp:start_t", 0.0);
-  auto start_x = local_state<double>(state_key + ":lp:start_x", 0.0);
-  auto start_y = local_state<double>(state_key + ":lp:start_y", 0.0);
+  const StateKey slot_key{state_key};
+  auto pressed = local_state<bool>(slot_key.with(":lp:pressed"), false);
+  auto start_t = local_state<double>(slot_key.with(":lp:start_t"), 0.0);
+  auto start_x = local_state<double>(slot_key.with(":lp:start_x"), 0.0);
+  auto start_y = local_state<double>(slot_key.with(":lp:start_y"), 0.0);
 
-  const auto prev_down = [&]() -> std::uint64_t {
-    if (const auto it = node.events.find("pointer_down");
-        it != node.events.end()) {
-      return it->second;
-    }
-    return 0;
-  }();
-  const auto prev_move = [&]() -> std::uint64_t {
-    if (const auto it = node.events.find("pointer_move");
-        it != node.events.end()) {
-      return it->second;
-    }
-    return 0;
-  }();
-  const auto prev_up = [&]() -> std::uint64_t {
-    if (const auto it = node.events.find("pointer_up");
-        it != node.events.end()) {
-      return it->second;
-    }
-    return 0;
-  }();
+  const auto prev_down = node.events.get(EventKind::PointerDown);
+  const auto prev_move = node.events.get(EventKind::PointerMove);
+  const auto prev_up = node.events.get(EventKind::PointerUp);
 
-  node.events.insert_or_assign(
-      "pointer_down",
+  node.events.set(
+      EventKind::PointerDown,
       chain_handler(prev_down, [pressed, start_t, start_x, start_y]() mutable {
         pressed.set(true);
         start_t.set(now_ms());
@@ -4453,8 +5533,8 @@ inline ViewNode onLongPressGesture(ViewNode node, std::string key,
         capture_pointer();
       }));
 
-  node.events.insert_or_assign(
-      "pointer_move",
+  node.events.set(
+      EventKind::PointerMove,
       chain_handler(prev_move, [pressed, start_x, start_y, maximum_distance]() mutable {
         if (!pressed.get()) {
           return;
@@ -4467,8 +5547,8 @@ inline ViewNode onLongPressGesture(ViewNode node, std::string key,
         }
       }));
 
-  node.events.insert_or_assign(
-      "pointer_up",
+  node.events.set(
+      EventKind::PointerUp,
       chain_handler(prev_up, [pressed, start_t, minimum_duration_ms, fn = std::move(fn)]() mutable {
         if (pressed.get()) {
           const double dt = now_ms() - start_t.get();
@@ -4500,34 +5580,17 @@ inline ViewNode MagnificationGesture(
   }
   const std::string state_key = node.key.empty() ? std::move(key) : node.key;
 
-  auto active = local_state<bool>(state_key + ":mag:active", false);
-  auto start_y = local_state<double>(state_key + ":mag:start_y", 0.0);
-  auto last = local_state<double>(state_key + ":mag:last", 1.0);
+  const StateKey slot_key{state_key};
+  auto active = local_state<bool>(slot_key.with(":mag:active"), false);
+  auto start_y = local_state<double>(slot_key.with(":mag:start_y"), 0.0);
+  auto last = local_state<double>(slot_key.with(":mag:last"), 1.0);
 
-  const auto prev_down = [&]() -> std::uint64_t {
-    if (const auto it = node.events.find("pointer_down");
-        it != node.events.end()) {
-      return it->second;
-    }
-    return 0;
-  }();
-  const auto prev_move = [&]() -> std::uint64_t {
-    if (const auto it = node.events.find("pointer_move");
-        it != node.events.end()) {
-      return it->second;
-    }
-    return 0;
-  }();
-  const auto prev_up = [&]() -> std::uint64_t {
-    if (const auto it = node.events.find("pointer_up");
-        it != node.events.end()) {
-      return it->second;
-    }
-    return 0;
-  }();
+  const auto prev_down = node.events.get(EventKind::PointerDown);
+  const auto prev_move = node.events.get(EventKind::PointerMove);
+  const auto prev_up = node.events.get(EventKind::PointerUp);
 
-  node.events.insert_or_assign(
-      "pointer_down",
+  node.events.set(
+      EventKind::PointerDown,
       chain_handler(prev_down, [active, start_y, last]() mutable {
         active.set(true);
         start_y.set(pointer_y());
@@ -4535,8 +5598,8 @@ inline ViewNode MagnificationGesture(
         capture_pointer();
       }));
 
-  node.events.insert_or_assign(
-      "pointer_move",
+  node.events.set(
+      EventKind::PointerMove,
       chain_handler(prev_move, [active, start_y, last, sensitivity, on_changed]() mutable {
         if (!active.get()) {
           return;
@@ -4550,8 +5613,8 @@ inline ViewNode MagnificationGesture(
         }
       }));
 
-  node.events.insert_or_assign(
-      "pointer_up",
+  node.events.set(
+      EventKind::PointerUp,
       chain_handler(prev_up, [active, last, on_ended]() mutable {
         if (!active.get()) {
           return;
@@ -4582,34 +5645,17 @@ inline ViewNode RotationGesture(
   }
   const std::string state_key = node.key.empty() ? std::move(key) : node.key;
 
-  auto active = local_state<bool>(state_key + ":rot:active", false);
-  auto start_x = local_state<double>(state_key + ":rot:start_x", 0.0);
-  auto last = local_state<double>(state_key + ":rot:last", 0.0);
+  const StateKey slot_key{state_key};
+  auto active = local_state<bool>(slot_key.with(":rot:active"), false);
+  auto start_x = local_state<double>(slot_key.with(":rot:start_x"), 0.0);
+  auto last = local_state<double>(slot_key.with(":rot:last"), 0.0);
 
-  const auto prev_down = [&]() -> std::uint64_t {
-    if (const auto it = node.events.find("pointer_down");
-        it != node.events.end()) {
-      return it->second;
-    }
-    return 0;
-  }();
-  const auto prev_move = [&]() -> std::uint64_t {
-    if (const auto it = node.events.find("pointer_move");
-        it != node.events.end()) {
-      return it->second;
-    }
-    return 0;
-  }();
-  const auto prev_up = [&]() -> std::uint64_t {
-    if (const auto it = node.events.find("pointer_up");
-        it != node.events.end()) {
-      return it->second;
-    }
-    return 0;
-  }();
+  const auto prev_down = node.events.get(EventKind::PointerDown);
+  const auto prev_move = node.events.get(EventKind::PointerMove);
+  const auto prev_up = node.events.get(EventKind::PointerUp);
 
-  node.events.insert_or_assign(
-      "pointer_down",
+  node.events.set(
+      EventKind::PointerDown,
       chain_handler(prev_down, [active, start_x, last]() mutable {
         active.set(true);
         start_x.set(pointer_x());
@@ -4617,8 +5663,8 @@ inline ViewNode RotationGesture(
         capture_pointer();
       }));
 
-  node.events.insert_or_assign(
-      "pointer_move",
+  node.events.set(
+      EventKind::PointerMove,
       chain_handler(prev_move, [active, start_x, last, sensitivity, on_changed]() mutable {
         if (!active.get()) {
           return;
@@ -4632,8 +5678,8 @@ inline ViewNode RotationGesture(
         }
       }));
 
-  node.events.insert_or_assign(
-      "pointer_up",
+  node.events.set(
+      EventKind::PointerUp,
       chain_handler(prev_up, [active, last, on_ended]() mutable {
         if (!active.get()) {
           return;
@@ -4783,8 +5829,9 @@ inline ViewNode PhotosPicker(StateHandle<std::string> selection,
 
 inline ViewNode TextField(StateHandle<std::string> value, std::string key,
                           std::string placeholder = {}) {
-  auto focused = local_state<bool>(key + ":focused", false);
-  auto caret = local_state<std::int64_t>(key + ":caret", 0);
+  const StateKey slot_key{key};
+  auto focused = local_state<bool>(slot_key.with(":focused"), false);
+  auto caret = local_state<std::int64_t>(slot_key.with(":caret"), 0);
 
   auto b = view("TextField");
   b.key(key);
@@ -4864,8 +5911,9 @@ inline ViewNode SecureField(StateHandle<std::string> value, std::string key,
     b.prop("placeholder", std::move(placeholder));
   }
 
-  auto focused = local_state<bool>(key + ":focused", false);
-  auto caret = local_state<std::int64_t>(key + ":caret", 0);
+  const StateKey slot_key{key};
+  auto focused = local_state<bool>(slot_key.with(":focused"), false);
+  auto caret = local_state<std::int64_t>(slot_key.with(":caret"), 0);
   b.prop("caret", caret.get());
   b.prop("focused", focused.get());
 
@@ -4929,8 +5977,9 @@ inline ViewNode SecureField(StateHandle<std::string> value, std::string key,
 }
 
 inline ViewNode TextEditor(StateHandle<std::string> value, std::string key) {
-  auto focused = local_state<bool>(key + ":focused", false);
-  auto caret = local_state<std::int64_t>(key + ":caret", 0);
+  const StateKey slot_key{key};
+  auto focused = local_state<bool>(slot_key.with(":focused"), false);
+  auto caret = local_state<std::int64_t>(slot_key.with(":caret"), 0);
 
   auto b = view("TextEditor");
   b.key(key);
@@ -0,0 +1,570 @@
+#pragma once
+
+#include <duorou/ui/base_render.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) ||                                     \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DUOROU_SOFTWARE_SSE2 1
+#endif
+
+namespace duorou::ui {
+
+struct SoftwareTexture {
+  int w{};
+  int h{};
+  int channels{4};
+  std::vector<std::uint8_t> pixels{};
+};
+
+namespace detail {
+
+inline std::uint32_t sw_lerp_channel(std::uint32_t s, std::uint32_t d,
+                                     std::uint32_t a) {
+  std::uint32_t x = s * a + d * (255u - a) + 128u;
+  return (x + (x >> 8)) >> 8;
+}
+
+inline std::uint32_t sw_blend_pixel(std::uint32_t dst, std::uint32_t src) {
+  const std::uint32_t a = src >> 24;
+  if (a == 255u) {
+    return src;
+  }
+  if (a == 0u) {
+    return dst;
+  }
+  const auto r = sw_lerp_channel(src & 0xFFu, dst & 0xFFu, a);
+  const auto g = sw_lerp_channel((src >> 8) & 0xFFu, (dst >> 8) & 0xFFu, a);
+  const auto b = sw_lerp_channel((src >> 16) & 0xFFu, (dst >> 16) & 0xFFu, a);
+  const auto o = sw_lerp_channel(255u, dst >> 24, a);
+  return r | (g << 8) | (b << 16) | (o << 24);
+}
+
+inline void sw_blend_row(std::uint32_t *dst, const std::uint32_t *src, int n) {
+  int i = 0;
+#if defined(DUOROU_SOFTWARE_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i c255 = _mm_set1_epi16(255);
+  const __m128i c128 = _mm_set1_epi16(128);
+  const __m128i alpha_bits = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+  for (; i + 4 <= n; i += 4) {
+    const __m128i s =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+    const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+
+    __m128i a = _mm_srli_epi32(s, 24);
+    a = _mm_or_si128(a, _mm_slli_epi32(a, 8));
+    a = _mm_or_si128(a, _mm_slli_epi32(a, 16));
+    const __m128i so = _mm_or_si128(s, alpha_bits);
+
+    const __m128i s_lo = _mm_unpacklo_epi8(so, zero);
+    const __m128i s_hi = _mm_unpackhi_epi8(so, zero);
+    const __m128i d_lo = _mm_unpacklo_epi8(d, zero);
+    const __m128i d_hi = _mm_unpackhi_epi8(d, zero);
+    const __m128i a_lo = _mm_unpacklo_epi8(a, zero);
+    const __m128i a_hi = _mm_unpackhi_epi8(a, zero);
+
+    __m128i x_lo = _mm_add_epi16(
+        _mm_add_epi16(_mm_mullo_epi16(s_lo, a_lo),
+                      _mm_mullo_epi16(d_lo, _mm_sub_epi16(c255, a_lo))),
+        c128);
+    __m128i x_hi = _mm_add_epi16(
+        _mm_add_epi16(_mm_mullo_epi16(s_hi, a_hi),
+                      _mm_mullo_epi16(d_hi, _mm_sub_epi16(c255, a_hi))),
+        c128);
+    x_lo = _mm_srli_epi16(_mm_add_epi16(x_lo, _mm_srli_epi16(x_lo, 8)), 8);
+    x_hi = _mm_srli_epi16(_mm_add_epi16(x_hi, _mm_srli_epi16(x_hi, 8)), 8);
+
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),
+                     _mm_packus_epi16(x_lo, x_hi));
+  }
+#endif
+  for (; i < n; ++i) {
+    dst[i] = sw_blend_pixel(dst[i], src[i]);
+  }
+}
+
+inline std::uint32_t sw_blend_pixel_premultiplied(std::uint32_t dst,
+                                                  std::uint32_t src) {
+  const std::uint32_t inv = 255u - (src >> 24);
+  std::uint32_t out = 0;
+  for (int c = 0; c < 4; ++c) {
+    const std::uint32_t sc = (src >> (c * 8)) & 0xFFu;
+    const std::uint32_t dc = (dst >> (c * 8)) & 0xFFu;
+    std::uint32_t x = dc * inv + 128u;
+    x = sc + ((x + (x >> 8)) >> 8);
+    out |= std::min<std::uint32_t>(x, 255u) << (c * 8);
+  }
+  return out;
+}
+
+inline void sw_blend_row_premultiplied(std::uint32_t *dst,
+                                       const std::uint32_t *src, int n) {
+  int i = 0;
+#if defined(DUOROU_SOFTWARE_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i c255 = _mm_set1_epi16(255);
+  const __m128i c128 = _mm_set1_epi16(128);
+  for (; i + 4 <= n; i += 4) {
+    const __m128i s =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+    const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+
+    __m128i a = _mm_srli_epi32(s, 24);
+    a = _mm_or_si128(a, _mm_slli_epi32(a, 8));
+    a = _mm_or_si128(a, _mm_slli_epi32(a, 16));
+    const __m128i inv_lo = _mm_sub_epi16(c255, _mm_unpacklo_epi8(a, zero));
+    const __m128i inv_hi = _mm_sub_epi16(c255, _mm_unpackhi_epi8(a, zero));
+
+    __m128i x_lo =
+        _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), inv_lo), c128);
+    __m128i x_hi =
+        _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), inv_hi), c128);
+    x_lo = _mm_srli_epi16(_mm_add_epi16(x_lo, _mm_srli_epi16(x_lo, 8)), 8);
+    x_hi = _mm_srli_epi16(_mm_add_epi16(x_hi, _mm_srli_epi16(x_hi, 8)), 8);
+
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),
+                     _mm_adds_epu8(s, _mm_packus_epi16(x_lo, x_hi)));
+  }
+#endif
+  for (; i < n; ++i) {
+    dst[i] = sw_blend_pixel_premultiplied(dst[i], src[i]);
+  }
+}
+
+inline std::uint32_t sw_modulate_pixel(std::uint32_t a, std::uint32_t b) {
+  std::uint32_t out = 0;
+  for (int c = 0; c < 4; ++c) {
+    const std::uint32_t x =
+        ((a >> (c * 8)) & 0xFFu) * ((b >> (c * 8)) & 0xFFu) + 128u;
+    out |= ((x + (x >> 8)) >> 8) << (c * 8);
+  }
+  return out;
+}
+
+inline void sw_modulate_row(std::uint32_t *row, std::uint32_t color, int n) {
+  if (color == 0xFFFFFFFFu) {
+    return;
+  }
+  int i = 0;
+#if defined(DUOROU_SOFTWARE_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i c128 = _mm_set1_epi16(128);
+  const __m128i m =
+      _mm_unpacklo_epi8(_mm_set1_epi32(static_cast<int>(color)), zero);
+  for (; i + 4 <= n; i += 4) {
+    const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + i));
+    __m128i x_lo =
+        _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(p, zero), m), c128);
+    __m128i x_hi =
+        _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(p, zero), m), c128);
+    x_lo = _mm_srli_epi16(_mm_add_epi16(x_lo, _mm_srli_epi16(x_lo, 8)), 8);
+    x_hi = _mm_srli_epi16(_mm_add_epi16(x_hi, _mm_srli_epi16(x_hi, 8)), 8);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(row + i),
+                     _mm_packus_epi16(x_lo, x_hi));
+  }
+#endif
+  for (; i < n; ++i) {
+    row[i] = sw_modulate_pixel(row[i], color);
+  }
+}
+
+inline std::uint32_t sw_crc32(const std::uint8_t *data, std::size_t n,
+                              std::uint32_t crc = 0) {
+  static const auto table = [] {
+    std::array<std::uint32_t, 256> t{};
+    for (std::uint32_t i = 0; i < 256; ++i) {
+      std::uint32_t c = i;
+      for (int k = 0; k < 8; ++k) {
+        c = (c & 1u) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+      }
+      t[i] = c;
+    }
+    return t;
+  }();
+  crc = ~crc;
+  for (std::size_t i = 0; i < n; ++i) {
+    crc = table[(crc ^ data[i]) & 0xFFu] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+} // namespace detail
+
+class SoftwareRasterizer {
+public:
+  void resize(int w, int h) {
+    w_ = std::max(0, w);
+    h_ = std::max(0, h);
+    pixels_.assign(static_cast<std::size_t>(w_) * static_cast<std::size_t>(h_),
+                   0u);
+  }
+
+  int width() const { return w_; }
+  int height() const { return h_; }
+
+  const std::vector<std::uint32_t> &pixels() const { return pixels_; }
+
+  std::uint64_t pixels_written() const { return pixels_written_; }
+
+  void clear(ColorU8 c) {
+    std::fill(pixels_.begin(), pixels_.end(), pack_rgba(c));
+  }
+
+  TextureHandle add_texture(SoftwareTexture tex) {
+    const auto h = next_texture_++;
+    textures_.insert_or_assign(h, std::move(tex));
+    return h;
+  }
+
+  SoftwareTexture *texture(TextureHandle h) {
+    const auto it = textures_.find(h);
+    return it == textures_.end() ? nullptr : &it->second;
+  }
+
+  void remove_texture(TextureHandle h) { textures_.erase(h); }
+
+  void draw_tree(const RenderTree &tree) { draw_tree(tree, {}); }
+
+  void draw_tree(const RenderTree &tree,
+                 const std::vector<RenderTransform> &transforms) {
+    for (const auto &b : tree.batches) {
+      if (b.count < 6) {
+        continue;
+      }
+      const RectF sc = batch_scissor(tree, b, transforms);
+      const int sx0 = std::clamp(static_cast<int>(std::floor(sc.x)), 0, w_);
+      const int sy0 = std::clamp(static_cast<int>(std::floor(sc.y)), 0, h_);
+      const int sx1 = std::clamp(static_cast<int>(std::ceil(sc.x + sc.w)), 0, w_);
+      const int sy1 = std::clamp(static_cast<int>(std::ceil(sc.y + sc.h)), 0, h_);
+      if (sx1 <= sx0 || sy1 <= sy0) {
+        continue;
+      }
+
+      const SoftwareTexture *tex = nullptr;
+      if (b.pipeline != RenderPipeline::Color) {
+        tex = texture(b.texture);
+        if (!tex || tex->w <= 0 || tex->h <= 0) {
+          continue;
+        }
+      }
+
+      const auto end = std::min(b.first + b.count, tree.vertices.size());
+      const auto *g = batch_transform_group(tree, b);
+      if (!g) {
+        for (std::size_t i = b.first; i + 6 <= end; i += 6) {
+          const auto &v0 = tree.vertices[i];
+          const auto &v1 = tree.vertices[i + 5];
+          draw_quad(b.pipeline, tex, v0, v1, sx0, sy0, sx1, sy1);
+        }
+        continue;
+      }
+      const auto t = batch_transform(tree, b, transforms);
+      auto place = [&](RenderVertex v) {
+        v.x = g->origin_x + (v.x - g->origin_x) * t.scale + t.dx;
+        v.y = g->origin_y + (v.y - g->origin_y) * t.scale + t.dy;
+        if (t.opacity < 1.0f) {
+          const auto a = clamp_u8(static_cast<int>(
+              std::lround(static_cast<float>(v.rgba >> 24) *
+                          std::clamp(t.opacity, 0.0f, 1.0f))));
+          v.rgba = (v.rgba & 0x00FFFFFFu) | (static_cast<std::uint32_t>(a) << 24);
+        }
+        return v;
+      };
+      for (std::size_t i = b.first; i + 6 <= end; i += 6) {
+        draw_quad(b.pipeline, tex, place(tree.vertices[i]),
+                  place(tree.vertices[i + 5]), sx0, sy0, sx1, sy1);
+      }
+    }
+  }
+
+  bool write_ppm(const std::string &path) const {
+    std::FILE *f = std::fopen(path.c_str(), "wb");
+    if (!f) {
+      return false;
+    }
+    std::fprintf(f, "P6\n%d %d\n255\n", w_, h_);
+    std::vector<std::uint8_t> row(static_cast<std::size_t>(w_) * 3u);
+    bool ok = true;
+    for (int y = 0; y < h_ && ok; ++y) {
+      const auto *src = pixels_.data() + static_cast<std::size_t>(y) * w_;
+      for (int x = 0; x < w_; ++x) {
+        row[static_cast<std::size_t>(x) * 3u + 0u] =
+            static_cast<std::uint8_t>(src[x] & 0xFFu);
+        row[static_cast<std::size_t>(x) * 3u + 1u] =
+            static_cast<std::uint8_t>((src[x] >> 8) & 0xFFu);
+        row[static_cast<std::size_t>(x) * 3u + 2u] =
+            static_cast<std::uint8_t>((src[x] >> 16) & 0xFFu);
+      }
+      ok = std::fwrite(row.data(), 1, row.size(), f) == row.size();
+    }
+    return std::fclose(f) == 0 && ok;
+  }
+
+  bool write_png(const std::string &path) const {
+    std::vector<std::uint8_t> raw;
+    raw.reserve((static_cast<std::size_t>(w_) * 4u + 1u) *
+                static_cast<std::size_t>(h_));
+    for (int y = 0; y < h_; ++y) {
+      raw.push_back(0);
+      const auto *src = pixels_.data() + static_cast<std::size_t>(y) * w_;
+      for (int x = 0; x < w_; ++x) {
+        raw.push_back(static_cast<std::uint8_t>(src[x] & 0xFFu));
+        raw.push_back(static_cast<std::uint8_t>((src[x] >> 8) & 0xFFu));
+        raw.push_back(static_cast<std::uint8_t>((src[x] >> 16) & 0xFFu));
+        raw.push_back(static_cast<std::uint8_t>((src[x] >> 24) & 0xFFu));
+      }
+    }
+
+    std::vector<std::uint8_t> z;
+    z.reserve(raw.size() + raw.size() / 65535u * 5u + 16u);
+    z.push_back(0x78);
+    z.push_back(0x01);
+    std::size_t pos = 0;
+    do {
+      const auto n = std::min<std::size_t>(65535u, raw.size() - pos);
+      z.push_back(pos + n == raw.size() ? 1 : 0);
+      z.push_back(static_cast<std::uint8_t>(n & 0xFFu));
+      z.push_back(static_cast<std::uint8_t>((n >> 8) & 0xFFu));
+      z.push_back(static_cast<std::uint8_t>(~n & 0xFFu));
+      z.push_back(static_cast<std::uint8_t>((~n >> 8) & 0xFFu));
+      z.insert(z.end(), raw.begin() + static_cast<std::ptrdiff_t>(pos),
+               raw.begin() + static_cast<std::ptrdiff_t>(pos + n));
+      pos += n;
+    } while (pos < raw.size());
+    std::uint32_t s1 = 1;
+    std::uint32_t s2 = 0;
+    for (const auto b : raw) {
+      s1 = (s1 + b) % 65521u;
+      s2 = (s2 + s1) % 65521u;
+    }
+    const std::uint32_t adler = (s2 << 16) | s1;
+    for (int k = 3; k >= 0; --k) {
+      z.push_back(static_cast<std::uint8_t>((adler >> (k * 8)) & 0xFFu));
+    }
+
+    std::vector<std::uint8_t> png{0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    auto put_u32 = [&](std::uint32_t v) {
+      for (int k = 3; k >= 0; --k) {
+        png.push_back(static_cast<std::uint8_t>((v >> (k * 8)) & 0xFFu));
+      }
+    };
+    auto chunk = [&](const char *type, const std::vector<std::uint8_t> &data) {
+      put_u32(static_cast<std::uint32_t>(data.size()));
+      const auto start = png.size();
+      png.insert(png.end(), type, type + 4);
+      png.insert(png.end(), data.begin(), data.end());
+      put_u32(detail::sw_crc32(png.data() + start, png.size() - start));
+    };
+
+    std::vector<std::uint8_t> ihdr;
+    for (const auto v : {static_cast<std::uint32_t>(w_),
+                         static_cast<std::uint32_t>(h_)}) {
+      for (int k = 3; k >= 0; --k) {
+        ihdr.push_back(static_cast<std::uint8_t>((v >> (k * 8)) & 0xFFu));
+      }
+    }
+    ihdr.insert(ihdr.end(), {8, 6, 0, 0, 0});
+    chunk("IHDR", ihdr);
+    chunk("IDAT", z);
+    chunk("IEND", {});
+
+    std::FILE *f = std::fopen(path.c_str(), "wb");
+    if (!f) {
+      return false;
+    }
+    const bool ok = std::fwrite(png.data(), 1, png.size(), f) == png.size();
+    return std::fclose(f) == 0 && ok;
+  }
+
+private:
+  static std::uint8_t sample_alpha(const SoftwareTexture &t, float u, float v) {
+    const int x = std::clamp(static_cast<int>(u * static_cast<float>(t.w)), 0,
+                             t.w - 1);
+    const int y = std::clamp(static_cast<int>(v * static_cast<float>(t.h)), 0,
+                             t.h - 1);
+    const auto idx = (static_cast<std::size_t>(y) * static_cast<std::size_t>(t.w) +
+                      static_cast<std::size_t>(x)) *
+                     static_cast<std::size_t>(t.channels);
+    return t.pixels[idx + static_cast<std::size_t>(t.channels - 1)];
+  }
+
+  static std::uint32_t sample_rgba(const SoftwareTexture &t, float u, float v) {
+    const int x = std::clamp(static_cast<int>(u * static_cast<float>(t.w)), 0,
+                             t.w - 1);
+    const int y = std::clamp(static_cast<int>(v * static_cast<float>(t.h)), 0,
+                             t.h - 1);
+    const auto idx = (static_cast<std::size_t>(y) * static_cast<std::size_t>(t.w) +
+                      static_cast<std::size_t>(x)) *
+                     static_cast<std::size_t>(t.channels);
+    if (t.channels < 4) {
+      const std::uint32_t g = t.pixels[idx];
+      return g | (g << 8) | (g << 16) |
+             (static_cast<std::uint32_t>(t.pixels[idx + static_cast<std::size_t>(
+                  t.channels - 1)])
+              << 24);
+    }
+    return static_cast<std::uint32_t>(t.pixels[idx]) |
+           (static_cast<std::uint32_t>(t.pixels[idx + 1]) << 8) |
+           (static_cast<std::uint32_t>(t.pixels[idx + 2]) << 16) |
+           (static_cast<std::uint32_t>(t.pixels[idx + 3]) << 24);
+  }
+
+  void draw_quad(RenderPipeline pipeline, const SoftwareTexture *tex,
+                 const RenderVertex &a, const RenderVertex &b, int sx0, int sy0,
+                 int sx1, int sy1) {
+    const float qx0 = std::min(a.x, b.x);
+    const float qx1 = std::max(a.x, b.x);
+    const float qy0 = std::min(a.y, b.y);
+    const float qy1 = std::max(a.y, b.y);
+    const int x0 = std::max(sx0, static_cast<int>(std::ceil(qx0 - 0.5f)));
+    const int x1 = std::min(sx1, static_cast<int>(std::ceil(qx1 - 0.5f)));
+    const int y0 = std::max(sy0, static_cast<int>(std::ceil(qy0 - 0.5f)));
+    const int y1 = std::min(sy1, static_cast<int>(std::ceil(qy1 - 0.5f)));
+    if (x1 <= x0 || y1 <= y0) {
+      return;
+    }
+    const int n = x1 - x0;
+
+    if (pipeline == RenderPipeline::Color) {
+      const std::uint32_t c = a.rgba;
+      if ((c >> 24) == 0u) {
+        return;
+      }
+      pixels_written_ += static_cast<std::uint64_t>(n) *
+                         static_cast<std::uint64_t>(y1 - y0);
+      if ((c >> 24) == 255u) {
+        for (int y = y0; y < y1; ++y) {
+          auto *dst = pixels_.data() + static_cast<std::size_t>(y) * w_ + x0;
+          std::fill(dst, dst + n, c);
+        }
+        return;
+      }
+      row_.assign(static_cast<std::size_t>(n), c);
+      for (int y = y0; y < y1; ++y) {
+        detail::sw_blend_row(pixels_.data() + static_cast<std::size_t>(y) * w_ + x0,
+                             row_.data(), n);
+      }
+      return;
+    }
+
+    pixels_written_ += static_cast<std::uint64_t>(n) *
+                       static_cast<std::uint64_t>(y1 - y0);
+    const float du = (b.u - a.u) / (b.x - a.x);
+    const float dv = (b.v - a.v) / (b.y - a.y);
+    const std::uint32_t col = a.rgba & 0x00FFFFFFu;
+    const std::uint32_t col_a = a.rgba >> 24;
+    row_.resize(static_cast<std::size_t>(n));
+    for (int y = y0; y < y1; ++y) {
+      const float v = a.v + (static_cast<float>(y) + 0.5f - a.y) * dv;
+      float u = a.u + (static_cast<float>(x0) + 0.5f - a.x) * du;
+      if (pipeline == RenderPipeline::Text) {
+        for (int i = 0; i < n; ++i, u += du) {
+          std::uint32_t m = sample_alpha(*tex, u, v) * col_a + 128u;
+          m = (m + (m >> 8)) >> 8;
+          row_[static_cast<std::size_t>(i)] = col | (m << 24);
+        }
+      } else {
+        for (int i = 0; i < n; ++i, u += du) {
+          row_[static_cast<std::size_t>(i)] = sample_rgba(*tex, u, v);
+        }
+        detail::sw_modulate_row(row_.data(), a.rgba, n);
+      }
+      auto *dst = pixels_.data() + static_cast<std::size_t>(y) * w_ + x0;
+      if (pipeline == RenderPipeline::Layer) {
+        detail::sw_blend_row_premultiplied(dst, row_.data(), n);
+      } else {
+        detail::sw_blend_row(dst, row_.data(), n);
+      }
+    }
+  }
+
+  int w_{};
+  int h_{};
+  std::vector<std::uint32_t> pixels_{};
+  std::vector<std::uint32_t> row_{};
+  std::unordered_map<TextureHandle, SoftwareTexture> textures_{};
+  TextureHandle next_texture_{1};
+  std::uint64_t pixels_written_{};
+};
+
+class SoftwareTextProvider final : public TextProvider {
+public:
+  explicit SoftwareTextProvider(SoftwareRasterizer &target) : target_{&target} {}
+
+  bool layout_text(std::string_view text, float font_px,
+                   TextLayout &out) override {
+    out.quads.clear();
+    out.caret_x.clear();
+    if (text.empty() || !(font_px > 0.0f)) {
+      return false;
+    }
+    if (glyph_ == 0) {
+      SoftwareTexture t;
+      t.w = 5;
+      t.h = 7;
+      t.channels = 1;
+      t.pixels.assign(35, 0);
+      for (int y = 1; y < 6; ++y) {
+        for (int x = 1; x < 4; ++x) {
+          t.pixels[static_cast<std::size_t>(y * 5 + x)] = 255;
+        }
+      }
+      glyph_ = target_->add_texture(std::move(t));
+    }
+
+    const float adv = font_px * 0.5f;
+    const float h = font_px * 1.2f;
+    const float gy0 = h * 0.5f - font_px * 0.35f;
+    const float gy1 = h * 0.5f + font_px * 0.35f;
+    float x = 0.0f;
+    out.caret_x.push_back(x);
+    for (std::size_t i = 0; i < text.size();) {
+      const auto b = static_cast<std::uint8_t>(text[i]);
+      std::size_t n = 1;
+      if ((b & 0xE0) == 0xC0) {
+        n = 2;
+      } else if ((b & 0xF0) == 0xE0) {
+        n = 3;
+      } else if ((b & 0xF8) == 0xF0) {
+        n = 4;
+      }
+      if (b != ' ' && b != '\t' && b != '\n') {
+        TextQuad q;
+        q.x0 = x;
+        q.y0 = gy0;
+        q.x1 = x + adv;
+        q.y1 = gy1;
+        q.u0 = 0.0f;
+        q.v0 = 0.0f;
+        q.u1 = 1.0f;
+        q.v1 = 1.0f;
+        q.texture = glyph_;
+        out.quads.push_back(q);
+      }
+      i += n;
+      x += adv;
+      out.caret_x.push_back(x);
+    }
+    out.w = std::max(1.0f, x);
+    out.h = h;
+    return true;
+  }
+
+private:
+  SoftwareRasterizer *target_{};
+  TextureHandle glyph_{};
+};
+
+} // namespace duorou::ui
@@ -3,9 +3,11 @@
 #include <duorou/ui/base_node.hpp>
 #include <duorou/ui/base_layout.hpp>
 
+#include <algorithm>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <limits>
 #include <optional>
 #include <string>
@@ -223,58 +225,239 @@ inline std::vector<StyleRule> parse_stylesheet_toml(std::string_view toml) {
   return rules;
 }
 
-inline void apply_styles_to_tree(ViewNode &root, const std::vector<StyleRule> &rules) {
-  auto apply_node = [&](auto &&self, ViewNode &node) -> void {
-    struct StyledValue {
-      PropValue value;
-      std::int32_t specificity{};
-      std::int32_t order{};
-    };
-    std::unordered_map<std::string, StyledValue> styled;
-
-    const auto classes = split_ws(prop_as_string(node.props, "class", ""));
-    const auto has_class = [&](const std::string &c) -> bool {
-      for (const auto &it : classes) {
-        if (it == c) {
-          return true;
+struct StyleClassHash {
+  using is_transparent = void;
+  std::size_t operator()(std::string_view s) const {
+    return std::hash<std::string_view>{}(s);
+  }
+};
+
+class StyleIndex {
+public:
+  static constexpr std::size_t kMaxCached = 4096;
+
+  StyleIndex() = default;
+
+  explicit StyleIndex(std::vector<StyleRule> rules) { assign(std::move(rules)); }
+  StyleIndex(const StyleIndex &) = delete;
+  StyleIndex &operator=(const StyleIndex &) = delete;
+  StyleIndex(StyleIndex &&) = default;
+  StyleIndex &operator=(StyleIndex &&) = default;
+
+  void assign(std::vector<StyleRule> rules) {
+    rules_ = std::move(rules);
+    class_ids_.clear();
+    by_key_.clear();
+    by_type_.clear();
+    by_class_.clear();
+    universal_.clear();
+    rule_class_.assign(rules_.size(), kNoClass);
+    memo_.clear();
+    cache_.clear();
+
+    for (std::uint32_t i = 0; i < rules_.size(); ++i) {
+      const auto &r = rules_[i];
+      if (!r.cls.empty()) {
+        auto it = class_ids_.find(r.cls);
+        if (it == class_ids_.end()) {
+          it = class_ids_.emplace(r.cls, static_cast<std::uint32_t>(by_class_.size())).first;
+          by_class_.emplace_back();
         }
+        rule_class_[i] = it->second;
       }
-      return false;
-    };
+      if (!r.key.empty()) {
+        by_key_[r.key].push_back(i);
+      } else if (rule_class_[i] != kNoClass) {
+        by_class_[rule_class_[i]].push_back(i);
+      } else if (!r.type.empty()) {
+        by_type_[r.type].push_back(i);
+      } else {
+        universal_.push_back(i);
+      }
+    }
+  }
 
-    for (const auto &r : rules) {
-      if (!r.key.empty() && node.key != r.key) {
-        continue;
+  const std::vector<StyleRule> &rules() const { return rules_; }
+  bool empty() const { return rules_.empty(); }
+  std::size_t cached_signatures() const { return cache_.size(); }
+
+  void apply(ViewNode &root) {
+    if (!rules_.empty()) {
+      apply_node(root);
+    }
+  }
+
+private:
+  static constexpr std::uint32_t kNoClass = 0xFFFFFFFFu;
+
+  using Resolved = std::vector<std::pair<const std::string *, const PropValue *>>;
+
+  struct CacheEntry {
+    std::string type;
+    std::string key;
+    std::vector<std::uint32_t> classes;
+    Resolved decls;
+  };
+
+  struct Winner {
+    const std::string *key{};
+    const PropValue *value{};
+    std::int32_t specificity{};
+    std::int32_t order{};
+  };
+
+  void collect_classes(const ViewNode &node) {
+    classes_.clear();
+    const auto *pv = find_prop(node.props, "class");
+    const auto *s = pv ? std::get_if<std::string>(pv) : nullptr;
+    if (!s) {
+      return;
+    }
+    const std::string_view v{*s};
+    std::size_t i = 0;
+    while (i < v.size()) {
+      while (i < v.size() && (v[i] == ' ' || v[i] == '\t' || v[i] == '\r' || v[i] == '\n')) {
+        ++i;
       }
-      if (!r.type.empty() && node.type != r.type) {
-        continue;
+      const std::size_t start = i;
+      while (i < v.size() && !(v[i] == ' ' || v[i] == '\t' || v[i] == '\r' || v[i] == '\n')) {
+        ++i;
       }
-      if (!r.cls.empty() && !has_class(r.cls)) {
+      if (start < i) {
+        const auto it = class_ids_.find(v.substr(start, i - start));
+        if (it != class_ids_.end()) {
+          classes_.push_back(it->second);
+        }
+      }
+    }
+    std::sort(classes_.begin(), classes_.end());
+    classes_.erase(std::unique(classes_.begin(), classes_.end()), classes_.end());
+  }
+
+  bool has_class(std::uint32_t id) const {
+    return std::binary_search(classes_.begin(), classes_.end(), id);
+  }
+
+  bool matches(std::uint32_t i, const ViewNode &node) const {
+    const auto &r = rules_[i];
+    if (!r.key.empty() && node.key != r.key) {
+      return false;
+    }
+    if (!r.type.empty() && node.type != r.type) {
+      return false;
+    }
+    if (!r.cls.empty() && !has_class(rule_class_[i])) {
+      return false;
+    }
+    return true;
+  }
+
+  void consider(const std::vector<std::uint32_t> &bucket, const ViewNode &node) {
+    for (const auto i : bucket) {
+      if (!matches(i, node)) {
         continue;
       }
+      const auto &r = rules_[i];
       for (const auto &kv : r.decls) {
-        const auto it = styled.find(kv.first);
-        if (it == styled.end() ||
-            r.specificity > it->second.specificity ||
-            (r.specificity == it->second.specificity && r.order >= it->second.order)) {
-          styled.insert_or_assign(kv.first,
-                                  StyledValue{kv.second, r.specificity, r.order});
+        const auto [it, inserted] = winners_.try_emplace(
+            std::string_view{kv.first}, Winner{&kv.first, &kv.second, r.specificity, r.order});
+        if (!inserted && (r.specificity > it->second.specificity ||
+                          (r.specificity == it->second.specificity &&
+                           r.order >= it->second.order))) {
+          it->second = Winner{&kv.first, &kv.second, r.specificity, r.order};
         }
       }
     }
+  }
+
+  void resolve(const ViewNode &node, bool keyed, Resolved &out) {
+    winners_.clear();
+    if (keyed) {
+      consider(by_key_.find(node.key)->second, node);
+    }
+    if (const auto it = by_type_.find(node.type); it != by_type_.end()) {
+      consider(it->second, node);
+    }
+    for (const auto id : classes_) {
+      consider(by_class_[id], node);
+    }
+    consider(universal_, node);
+    out.clear();
+    out.reserve(winners_.size());
+    for (const auto &kv : winners_) {
+      out.emplace_back(kv.second.key, kv.second.value);
+    }
+  }
 
-    for (const auto &kv : styled) {
-      if (!node.props.contains(kv.first)) {
-        node.props.insert_or_assign(kv.first, kv.second.value);
+  const Resolved &lookup(const ViewNode &node) {
+    const bool keyed = !node.key.empty() && by_key_.contains(node.key);
+    std::size_t h = std::hash<std::string_view>{}(node.type);
+    if (keyed) {
+      h = h * 1099511628211ull ^ std::hash<std::string_view>{}(node.key);
+    }
+    for (const auto id : classes_) {
+      h = (h ^ id) * 1099511628211ull;
+    }
+
+    const auto it = cache_.find(h);
+    if (it != cache_.end()) {
+      const auto &e = memo_[it->second];
+      if (e.type == node.type && e.classes == classes_ &&
+          (keyed ? e.key == node.key : e.key.empty())) {
+        return e.decls;
       }
+      resolve(node, keyed, scratch_);
+      return scratch_;
+    }
+
+    if (memo_.size() >= kMaxCached) {
+      memo_.clear();
+      cache_.clear();
     }
+    auto &e = memo_.emplace_back();
+    e.type = node.type;
+    if (keyed) {
+      e.key = node.key;
+    }
+    e.classes = classes_;
+    resolve(node, keyed, e.decls);
+    cache_.emplace(h, memo_.size() - 1);
+    return e.decls;
+  }
 
+  void apply_node(ViewNode &node) {
+    collect_classes(node);
+    for (const auto &[k, v] : lookup(node)) {
+      if (!node.props.contains(*k)) {
+        node.props.insert_or_assign(*k, *v);
+      }
+    }
     for (auto &ch : node.children) {
-      self(self, ch);
+      apply_node(ch);
     }
-  };
+  }
+
+  std::vector<StyleRule> rules_{};
+  std::vector<std::uint32_t> rule_class_{};
+  std::unordered_map<std::string, std::uint32_t, StyleClassHash, std::equal_to<>> class_ids_{};
+  std::unordered_map<std::string, std::vector<std::uint32_t>> by_key_{};
+  std::unordered_map<std::string, std::vector<std::uint32_t>> by_type_{};
+  std::vector<std::vector<std::uint32_t>> by_class_{};
+  std::vector<std::uint32_t> universal_{};
+  std::vector<CacheEntry> memo_{};
+  std::unordered_map<std::size_t, std::size_t> cache_{};
+  std::vector<std::uint32_t> classes_{};
+  std::unordered_map<std::string_view, Winner> winners_{};
+  Resolved scratch_{};
+};
 
-  apply_node(apply_node, root);
+inline void apply_styles_to_tree(ViewNode &root, StyleIndex &index) {
+  index.apply(root);
+}
+
+inline void apply_styles_to_tree(ViewNode &root, const std::vector<StyleRule> &rules) {
+  StyleIndex index{rules};
+  index.apply(root);
 }
 
 } // namespace detail
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <duorou/ui/event_handler.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace duorou::ui {
+
+class ThreadPool {
+public:
+  explicit ThreadPool(std::size_t threads = default_threads()) {
+    threads = std::max<std::size_t>(1, threads);
+    queues_.reserve(threads - 1);
+    for (std::size_t i = 1; i < threads; ++i) {
+      queues_.push_back(std::make_unique<WorkerQueue>());
+    }
+    workers_.reserve(threads - 1);
+    for (std::size_t i = 0; i + 1 < threads; ++i) {
+      workers_.emplace_back([this, i] { run(i); });
+    }
+  }
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock{mu_};
+      stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto &t : workers_) {
+      t.join();
+    }
+  }
+
+  static std::size_t default_threads() {
+    return std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  std::size_t size() const { return workers_.size() + 1; }
+
+  void submit(EventHandler fn) {
+    if (workers_.empty()) {
+      fn();
+      return;
+    }
+    auto &q = *queues_[next_queue_.fetch_add(1, std::memory_order_relaxed) %
+                       queues_.size()];
+    {
+      std::lock_guard<std::mutex> lock{mu_};
+      pending_.fetch_add(1, std::memory_order_relaxed);
+    }
+    {
+      std::lock_guard<std::mutex> lock{q.mu};
+      q.tasks.push_back(std::move(fn));
+    }
+    cv_.notify_one();
+  }
+
+  template <typename F> void parallel_for(std::size_t n, F &&fn) {
+    if (n == 0) {
+      return;
+    }
+    if (n == 1 || workers_.empty()) {
+      for (std::size_t i = 0; i < n; ++i) {
+        fn(i);
+      }
+      return;
+    }
+
+    struct Shared {
+      std::atomic<std::size_t> next{};
+      std::size_t done{};
+      std::mutex mu;
+      std::condition_variable cv;
+    };
+    auto shared = std::make_shared<Shared>();
+    auto *body = &fn;
+    auto drain = [shared, body, n] {
+      std::size_t finished = 0;
+      for (;;) {
+        const auto i = shared->next.fetch_add(1, std::memory_order_relaxed);
+        if (i >= n) {
+          break;
+        }
+        (*body)(i);
+        ++finished;
+      }
+      if (finished == 0) {
+        return;
+      }
+      std::lock_guard<std::mutex> lock{shared->mu};
+      shared->done += finished;
+      if (shared->done == n) {
+        shared->cv.notify_all();
+      }
+    };
+
+    const auto helpers = std::min(workers_.size(), n - 1);
+    for (std::size_t i = 0; i < helpers; ++i) {
+      submit(drain);
+    }
+    drain();
+
+    std::unique_lock<std::mutex> lock{shared->mu};
+    shared->cv.wait(lock, [&] { return shared->done == n; });
+  }
+
+private:
+  struct WorkerQueue {
+    std::mutex mu;
+    std::deque<EventHandler> tasks;
+  };
+
+  bool try_pop(std::size_t self, EventHandler &out) {
+    const auto n = queues_.size();
+    for (std::size_t k = 0; k < n; ++k) {
+      auto &q = *queues_[(self + k) % n];
+      std::lock_guard<std::mutex> lock{q.mu};
+      if (q.tasks.empty()) {
+        continue;
+      }
+      if (k == 0) {
+        out = std::move(q.tasks.front());
+        q.tasks.pop_front();
+      } else {
+        out = std::move(q.tasks.back());
+        q.tasks.pop_back();
+      }
+      pending_.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+    return false;
+  }
+
+  void run(std::size_t self) {
+    for (;;) {
+      EventHandler task;
+      if (try_pop(self, task)) {
+        task();
+        continue;
+      }
+      std::unique_lock<std::mutex> lock{mu_};
+      cv_.wait(lock, [&] {
+        return stop_ || pending_.load(std::memory_order_relaxed) != 0;
+      });
+      if (stop_ && pending_.load(std::memory_order_relaxed) == 0) {
+        return;
+      }
+    }
+  }
+
+  std::vector<std::unique_ptr<WorkerQueue>> queues_;
+  std::vector<std::thread> workers_;
+  std::atomic<std::size_t> next_queue_{};
+  std::atomic<std::size_t> pending_{};
+  std::mutex mu_;
+  std::condition_variable cv_;
+  bool stop_{};
+};
+
+} // namespace duorou::ui
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <duorou/ui/event_handler.hpp>
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace duorou::ui {
+
+class UiTaskQueue {
+public:
+  UiTaskQueue() = default;
+  UiTaskQueue(const UiTaskQueue &) = delete;
+  UiTaskQueue &operator=(const UiTaskQueue &) = delete;
+
+  ~UiTaskQueue() {
+    while (auto *n = pop()) {
+      delete n;
+    }
+  }
+
+  template <typename F> void post(F &&fn) {
+    push(new Node{EventHandler{std::forward<F>(fn)}});
+    if (!wake_pending_.exchange(true, std::memory_order_acq_rel)) {
+      std::function<void()> wake;
+      {
+        std::lock_guard<std::mutex> lock{wake_mu_};
+        wake = wake_;
+      }
+      if (wake) {
+        wake();
+      }
+    }
+  }
+
+  std::size_t drain() {
+    const auto self = std::this_thread::get_id();
+    std::thread::id owner{};
+    if (!owner_.compare_exchange_strong(owner, self,
+                                        std::memory_order_acq_rel) &&
+        owner != self) {
+      assert(!"UI tasks must be drained on the UI thread");
+      return 0;
+    }
+    if (draining_.exchange(true, std::memory_order_acquire)) {
+      return 0;
+    }
+    struct Release {
+      std::atomic<bool> &flag;
+      ~Release() { flag.store(false, std::memory_order_release); }
+    } release{draining_};
+    wake_pending_.store(false, std::memory_order_release);
+    std::size_t n = 0;
+    while (auto *node = pop()) {
+      std::unique_ptr<Node> owned{node};
+      ++n;
+      if (owned->fn) {
+        owned->fn();
+      }
+    }
+    return n;
+  }
+
+  void set_owner(std::thread::id id) {
+    owner_.store(id, std::memory_order_release);
+  }
+
+  void set_wakeup(std::function<void()> fn) {
+    std::lock_guard<std::mutex> lock{wake_mu_};
+    wake_ = std::move(fn);
+  }
+
+private:
+  struct Node {
+    EventHandler fn{};
+    std::atomic<Node *> next{nullptr};
+  };
+
+  void push(Node *n) {
+    n->next.store(nullptr, std::memory_order_relaxed);
+    auto *prev = head_.exchange(n, std::memory_order_acq_rel);
+    prev->next.store(n, std::memory_order_release);
+  }
+
+  Node *pop() {
+    auto *tail = tail_;
+    auto *next = tail->next.load(std::memory_order_acquire);
+    if (tail == &stub_) {
+      if (!next) {
+        return nullptr;
+      }
+      tail_ = next;
+      tail = next;
+      next = next->next.load(std::memory_order_acquire);
+    }
+    if (next) {
+      tail_ = next;
+      return tail;
+    }
+    if (tail != head_.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+    push(&stub_);
+    next = tail->next.load(std::memory_order_acquire);
+    if (next) {
+      tail_ = next;
+      return tail;
+    }
+    return nullptr;
+  }
+
+  Node stub_{};
+  std::atomic<Node *> head_{&stub_};
+  Node *tail_{&stub_};
+  std::atomic<std::thread::id> owner_{};
+  std::atomic<bool> draining_{false};
+  std::atomic<bool> wake_pending_{false};
+  std::mutex wake_mu_{};
+  std::function<void()> wake_{};
+};
+
+inline UiTaskQueue &ui_task_queue() {
+  static UiTaskQueue q;
+  return q;
+}
+
+template <typename F> inline void post_to_ui(F &&fn) {
+  ui_task_queue().post(std::forward<F>(fn));
+}
+
+inline void set_ui_wakeup(std::function<void()> fn) {
+  ui_task_queue().set_wakeup(std::move(fn));
+}
+
+inline void set_ui_thread(std::thread::id id = std::this_thread::get_id()) {
+  ui_task_queue().set_owner(id);
+}
+
+inline std::size_t drain_ui_tasks() { return ui_task_queue().drain(); }
+
+} // namespace duorou::ui
@@ -1,3 +1,4 @@
+#include <duorou/ui/frame_pipeline.hpp>
 #include <duorou/ui/runtime.hpp>
 
 #if !defined(_WIN32) && !defined(__linux__)
@@ -39,8 +40,11 @@ using GLfloat = float;
 #include <cstdlib>
 #include <cstring>
 #include <filesystem>
+#include <mutex>
 #include <string>
 #include <string_view>
+#include <thread>
+#include <type_traits>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -138,6 +142,24 @@ static std::string duorou_current_dir_string() {
 #if !defined(GL_ACTIVE_TEXTURE)
 #define GL_ACTIVE_TEXTURE 0x84E0
 #endif
+#if !defined(GL_TEXTURE1)
+#define GL_TEXTURE1 0x84C1
+#endif
+#if !defined(GL_TEXTURE_2D_ARRAY)
+#define GL_TEXTURE_2D_ARRAY 0x8C1A
+#endif
+#if !defined(GL_MAX_ARRAY_TEXTURE_LAYERS)
+#define GL_MAX_ARRAY_TEXTURE_LAYERS 0x88FF
+#endif
+#if !defined(GL_FRAMEBUFFER)
+#define GL_FRAMEBUFFER 0x8D40
+#endif
+#if !defined(GL_COLOR_ATTACHMENT0)
+#define GL_COLOR_ATTACHMENT0 0x8CE0
+#endif
+#if !defined(GL_FRAMEBUFFER_COMPLETE)
+#define GL_FRAMEBUFFER_COMPLETE 0x8CD5
+#endif
 
 struct GLProcs {
   using PFNGLGENBUFFERSPROC = void(DUOROU_GL_APIENTRY *)(GLsizei, GLuint *);
@@ -176,6 +198,7 @@ struct GLProcs {
   using PFNGLUNIFORMMATRIX4FVPROC =
       void(DUOROU_GL_APIENTRY *)(GLint, GLsizei, GLboolean, const GLfloat *);
   using PFNGLUNIFORM1IPROC = void(DUOROU_GL_APIENTRY *)(GLint, GLint);
+  using PFNGLUNIFORM1FPROC = void(DUOROU_GL_APIENTRY *)(GLint, GLfloat);
 
   using PFNGLGETATTRIBLOCATIONPROC =
       GLint(DUOROU_GL_APIENTRY *)(GLuint, const char *);
@@ -188,6 +211,23 @@ struct GLProcs {
                                 const void *);
 
   using PFNGLACTIVETEXTUREPROC = void(DUOROU_GL_APIENTRY *)(GLenum);
+  using PFNGLGENFRAMEBUFFERSPROC = void(DUOROU_GL_APIENTRY *)(GLsizei,
+                                                             GLuint *);
+  using PFNGLBINDFRAMEBUFFERPROC = void(DUOROU_GL_APIENTRY *)(GLenum, GLuint);
+  using PFNGLFRAMEBUFFERTEXTURE2DPROC =
+      void(DUOROU_GL_APIENTRY *)(GLenum, GLenum, GLenum, GLuint, GLint);
+  using PFNGLCHECKFRAMEBUFFERSTATUSPROC = GLenum(DUOROU_GL_APIENTRY *)(GLenum);
+  using PFNGLDELETEFRAMEBUFFERSPROC = void(DUOROU_GL_APIENTRY *)(GLsizei,
+                                                                const GLuint *);
+  using PFNGLBLENDFUNCSEPARATEPROC =
+      void(DUOROU_GL_APIENTRY *)(GLenum, GLenum, GLenum, GLenum);
+
+  using PFNGLTEXIMAGE3DPROC =
+      void(DUOROU_GL_APIENTRY *)(GLenum, GLint, GLint, GLsizei, GLsizei,
+                                GLsizei, GLint, GLenum, GLenum, const void *);
+  using PFNGLTEXSUBIMAGE3DPROC =
+      void(DUOROU_GL_APIENTRY *)(GLenum, GLint, GLint, GLint, GLint, GLsizei,
+                                GLsizei, GLsizei, GLenum, GLenum, const void *);
 
   using PFNGLGENVERTEXARRAYSPROC = void(DUOROU_GL_APIENTRY *)(GLsizei, GLuint *);
   using PFNGLBINDVERTEXARRAYPROC = void(DUOROU_GL_APIENTRY *)(GLuint);
@@ -218,6 +258,9 @@ struct GLProcs {
   PFNGLGETUNIFORMLOCATIONPROC GetUniformLocation{};
   PFNGLUNIFORMMATRIX4FVPROC UniformMatrix4fv{};
   PFNGLUNIFORM1IPROC Uniform1i{};
+  PFNGLUNIFORM1FPROC Uniform1f{};
+  PFNGLUNIFORM2FPROC Uniform2f{};
+  PFNGLUNIFORM4FPROC Uniform4f{};
 
   PFNGLGETATTRIBLOCATIONPROC GetAttribLocation{};
   PFNGLENABLEVERTEXATTRIBARRAYPROC EnableVertexAttribArray{};
@@ -226,6 +269,18 @@ struct GLProcs {
 
   PFNGLACTIVETEXTUREPROC ActiveTexture{};
 
+  PFNGLGENFRAMEBUFFERSPROC GenFramebuffers{};
+  PFNGLBINDFRAMEBUFFERPROC BindFramebuffer{};
+  PFNGLFRAMEBUFFERTEXTURE2DPROC FramebufferTexture2D{};
+  PFNGLCHECKFRAMEBUFFERSTATUSPROC CheckFramebufferStatus{};
+  PFNGLDELETEFRAMEBUFFERSPROC DeleteFramebuffers{};
+  PFNGLBLENDFUNCSEPARATEPROC BlendFuncSeparate{};
+  bool has_fbo{};
+
+  PFNGLTEXIMAGE3DPROC TexImage3D{};
+  PFNGLTEXSUBIMAGE3DPROC TexSubImage3D{};
+  bool has_tex_array{};
+
   PFNGLGENVERTEXARRAYSPROC GenVertexArrays{};
   PFNGLBINDVERTEXARRAYPROC BindVertexArray{};
   PFNGLDELETEVERTEXARRAYSPROC DeleteVertexArrays{};
@@ -264,6 +319,9 @@ static bool duorou_gl_load(GLProcs &gl) {
   ok = ok && duorou_gl_load_fn(gl.GetUniformLocation, "glGetUniformLocation");
   ok = ok && duorou_gl_load_fn(gl.UniformMatrix4fv, "glUniformMatrix4fv");
   ok = ok && duorou_gl_load_fn(gl.Uniform1i, "glUniform1i");
+  ok = ok && duorou_gl_load_fn(gl.Uniform1f, "glUniform1f");
+  ok = ok && duorou_gl_load_fn(gl.Uniform2f, "glUniform2f");
+  ok = ok && duorou_gl_load_fn(gl.Uniform4f, "glUniform4f");
 
   ok = ok && duorou_gl_load_fn(gl.GetAttribLocation, "glGetAttribLocation");
   ok = ok &&
@@ -274,6 +332,29 @@ static bool duorou_gl_load(GLProcs &gl) {
 
   ok = ok && duorou_gl_load_fn(gl.ActiveTexture, "glActiveTexture");
 
+  auto load_fbo = [&](const char *suffix) {
+    const std::string sfx{suffix};
+    return duorou_gl_load_fn(gl.GenFramebuffers,
+                             ("glGenFramebuffers" + sfx).c_str()) &&
+           duorou_gl_load_fn(gl.BindFramebuffer,
+                             ("glBindFramebuffer" + sfx).c_str()) &&
+           duorou_gl_load_fn(gl.FramebufferTexture2D,
+                             ("glFramebufferTexture2D" + sfx).c_str()) &&
+           duorou_gl_load_fn(gl.CheckFramebufferStatus,
+                             ("glCheckFramebufferStatus" + sfx).c_str()) &&
+           duorou_gl_load_fn(gl.DeleteFramebuffers,
+                             ("glDeleteFramebuffers" + sfx).c_str());
+  };
+  gl.has_fbo = duorou_gl_load_fn(gl.BlendFuncSeparate, "glBlendFuncSeparate") &&
+               (load_fbo("") || load_fbo("EXT"));
+
+  const auto *version =
+      reinterpret_cast<const char *>(glGetString(GL_VERSION));
+  const int major = version ? std::atoi(version) : 0;
+  gl.has_tex_array = major >= 3 &&
+                     duorou_gl_load_fn(gl.TexImage3D, "glTexImage3D") &&
+                     duorou_gl_load_fn(gl.TexSubImage3D, "glTexSubImage3D");
+
   gl.has_vao = duorou_gl_load_fn(gl.GenVertexArrays, "glGenVertexArrays") &&
                duorou_gl_load_fn(gl.BindVertexArray, "glBindVertexArray") &&
                duorou_gl_load_fn(gl.DeleteVertexArrays, "glDeleteVertexArrays");
@@ -387,23 +468,9 @@ static GLuint duorou_make_demo_rgba_texture() {
   return tex;
 }
 
-struct GLTextQuad {
-  float x0{};
-  float y0{};
-  float x1{};
-  float y1{};
-  float u0{};
-  float v0{};
-  float u1{};
-  float v1{};
-  GLuint texture{};
-};
-
-struct GLTextEntry {
-  int w{};
-  int h{};
-  std::vector<GLTextQuad> quads;
-  std::vector<float> caret_x;
+struct GLTextEntry : TextLayout {
+  std::string text;
+  int px100{};
 };
 
 static std::string duorou_readable_font_path() {
@@ -522,9 +589,13 @@ public:
   GLTextCache &operator=(const GLTextCache &) = delete;
 
   ~GLTextCache() {
-    for (auto &p : pages_) {
-      if (p.texture != 0) {
-        glDeleteTextures(1, &p.texture);
+    if (array_texture_ != 0) {
+      glDeleteTextures(1, &array_texture_);
+    } else {
+      for (auto &p : pages_) {
+        if (p.texture != 0) {
+          glDeleteTextures(1, &p.texture);
+        }
       }
     }
 
@@ -539,26 +610,58 @@ public:
   }
 
   const GLTextEntry *get(std::string_view text, float font_px) {
+    return get(text_run_hash(text), text, font_px);
+  }
+
+  const GLTextEntry *get(std::uint64_t hash, std::string_view text,
+                         float font_px) {
     if (text.empty()) {
       return nullptr;
     }
-    const auto key = make_key(text, font_px);
-    if (const auto it = cache_.find(key); it != cache_.end()) {
-      return &it->second;
+    const auto px100 = static_cast<int>(std::lround(font_px * 100.0f));
+    auto key = make_key(hash, px100);
+    std::lock_guard<std::mutex> lock{mu_};
+    for (auto it = cache_.find(key); it != cache_.end(); it = cache_.find(++key)) {
+      if (it->second.px100 == px100 && it->second.text == text) {
+        return &it->second;
+      }
+    }
+    if (std::this_thread::get_id() != owner_) {
+      return nullptr;
     }
 
     GLTextEntry e{};
     if (!build_entry(text, font_px, e)) {
       return nullptr;
     }
+    e.text.assign(text.data(), text.size());
+    e.px100 = px100;
 
-    auto [it, _] = cache_.emplace(key, e);
+    auto [it, _] = cache_.emplace(key, std::move(e));
     return &it->second;
   }
 
+  void enable_layers(GLProcs &gl) {
+    if (!gl.has_tex_array || !pages_.empty()) {
+      return;
+    }
+    GLint max_layers = 0;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+    if (max_layers <= 0) {
+      return;
+    }
+    gl_ = &gl;
+    max_layers_ = max_layers;
+  }
+
+  bool layered() const { return gl_ != nullptr; }
+
+  GLuint array_texture() const { return array_texture_; }
+
 private:
   struct AtlasPage {
     GLuint texture{};
+    std::uint32_t layer{};
     int w{};
     int h{};
     int pen_x{1};
@@ -568,6 +671,7 @@ private:
 
   struct CachedGlyph {
     GLuint texture{};
+    std::uint32_t layer{};
     int advance{};
     int bitmap_left{};
     int bitmap_top{};
@@ -579,14 +683,9 @@ private:
     float v1{};
   };
 
-  static std::string make_key(std::string_view text, float font_px) {
-    const auto scaled = static_cast<int>(std::lround(font_px * 100.0f));
-    std::string k;
-    k.reserve(16 + text.size());
-    k.append(std::to_string(scaled));
-    k.push_back(':');
-    k.append(text.data(), text.size());
-    return k;
+  static std::uint64_t make_key(std::uint64_t hash, int px100) {
+    return hash ^ (static_cast<std::uint64_t>(static_cast<std::uint32_t>(px100)) *
+                   0x9E3779B97F4A7C15ull);
   }
 
   static std::uint64_t make_glyph_key(std::uint32_t glyph_index, int px) {
@@ -628,6 +727,19 @@ private:
     AtlasPage p{};
     p.w = 1024;
     p.h = 1024;
+    if (layered()) {
+      p.layer = static_cast<std::uint32_t>(pages_.size());
+      if (!ensure_layers(p.layer + 1, p.w, p.h)) {
+        return nullptr;
+      }
+      p.texture = array_texture_;
+      pages_.push_back(p);
+      if (!alloc_in_page(pages_.back(), gw, gh, out_x, out_y)) {
+        return nullptr;
+      }
+      return &pages_.back();
+    }
+
     glGenTextures(1, &p.texture);
     if (p.texture == 0) {
       return nullptr;
@@ -652,6 +764,79 @@ private:
     return &pages_.back();
   }
 
+  bool ensure_layers(std::uint32_t count, int w, int h) {
+    if (count <= layer_cap_) {
+      layer_pixels_.resize(count);
+      layer_pixels_.back().assign(
+          static_cast<std::size_t>(w) * static_cast<std::size_t>(h), 0);
+      return true;
+    }
+    if (static_cast<GLint>(count) > max_layers_) {
+      return false;
+    }
+    if (array_texture_ == 0) {
+      glGenTextures(1, &array_texture_);
+      if (array_texture_ == 0) {
+        return false;
+      }
+    }
+
+    const auto cap = std::min<std::uint32_t>(
+        std::max<std::uint32_t>(layer_cap_ * 2, std::max(count, 4u)),
+        static_cast<std::uint32_t>(max_layers_));
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array_texture_);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    gl_->TexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_ALPHA, w, h,
+                    static_cast<GLsizei>(cap), 0, GL_ALPHA, GL_UNSIGNED_BYTE,
+                    nullptr);
+
+    layer_pixels_.resize(count);
+    layer_pixels_.back().assign(
+        static_cast<std::size_t>(w) * static_cast<std::size_t>(h), 0);
+    std::vector<std::uint8_t> zeros;
+    for (std::uint32_t i = 0; i < cap; ++i) {
+      const std::uint8_t *src = nullptr;
+      if (i < layer_pixels_.size()) {
+        src = layer_pixels_[i].data();
+      } else {
+        zeros.resize(static_cast<std::size_t>(w) * static_cast<std::size_t>(h));
+        src = zeros.data();
+      }
+      gl_->TexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, static_cast<GLint>(i),
+                         w, h, 1, GL_ALPHA, GL_UNSIGNED_BYTE, src);
+    }
+    layer_cap_ = cap;
+    return true;
+  }
+
+  void upload_glyph(const AtlasPage &page, int x, int y, int gw, int gh,
+                    const std::uint8_t *buf) {
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (!layered()) {
+      glBindTexture(GL_TEXTURE_2D, page.texture);
+      glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, gw, gh, GL_ALPHA,
+                      GL_UNSIGNED_BYTE, buf);
+      return;
+    }
+    auto &shadow = layer_pixels_[page.layer];
+    for (int row = 0; row < gh; ++row) {
+      std::memcpy(shadow.data() + static_cast<std::size_t>(y + row) *
+                                      static_cast<std::size_t>(page.w) +
+                      static_cast<std::size_t>(x),
+                  buf + static_cast<std::size_t>(row) *
+                            static_cast<std::size_t>(gw),
+                  static_cast<std::size_t>(gw));
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, page.texture);
+    gl_->TexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, x, y,
+                       static_cast<GLint>(page.layer), gw, gh, 1, GL_ALPHA,
+                       GL_UNSIGNED_BYTE, buf);
+  }
+
   const CachedGlyph *get_glyph(std::uint32_t glyph_index, int px) {
 #if !(defined(DUOROU_HAS_FREETYPE) && DUOROU_HAS_FREETYPE)
     (void)glyph_index;
@@ -707,14 +892,12 @@ private:
         std::memcpy(dst, src, static_cast<std::size_t>(gw));
       }
 
-      glBindTexture(GL_TEXTURE_2D, page->texture);
-      glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-      glTexSubImage2D(GL_TEXTURE_2D, 0, atlas_x, atlas_y, gw, gh, GL_ALPHA,
-                      GL_UNSIGNED_BYTE, buf.data());
+      upload_glyph(*page, atlas_x, atlas_y, gw, gh, buf.data());
     }
 
     CachedGlyph cg{};
     cg.texture = page->texture;
+    cg.layer = page->layer;
     cg.advance = static_cast<int>(face_->glyph->advance.x >> 6);
     cg.bitmap_left = face_->glyph->bitmap_left;
     cg.bitmap_top = face_->glyph->bitmap_top;
@@ -788,8 +971,8 @@ private:
     }
 
     const int pad = 2;
-    out.w = std::max(1, pen_x + pad * 2);
-    out.h = std::max(1, max_top + max_bottom + pad * 2);
+    out.w = static_cast<float>(std::max(1, pen_x + pad * 2));
+    out.h = static_cast<float>(std::max(1, max_top + max_bottom + pad * 2));
     out.quads.clear();
     out.caret_x.clear();
     out.caret_x.reserve(shaped.size() + 1);
@@ -803,7 +986,7 @@ private:
         const int dst_x0 = x + g.bitmap_left;
         const int dst_y0 = baseline - g.bitmap_top;
         if (g.w > 0 && g.h > 0) {
-          GLTextQuad q{};
+          TextQuad q{};
           q.x0 = static_cast<float>(dst_x0);
           q.y0 = static_cast<float>(dst_y0);
           q.x1 = static_cast<float>(dst_x0 + g.w);
@@ -812,7 +995,8 @@ private:
           q.v0 = g.v0;
           q.u1 = g.u1;
           q.v1 = g.v1;
-          q.texture = g.texture;
+          q.texture = static_cast<TextureHandle>(g.texture);
+          q.layer = g.layer;
           out.quads.push_back(q);
         }
       }
@@ -914,9 +1098,18 @@ private:
   int last_px_{};
 #endif
 
-  std::unordered_map<std::string, GLTextEntry> cache_;
+  std::unordered_map<std::uint64_t, GLTextEntry> cache_;
   std::unordered_map<std::uint64_t, CachedGlyph> glyphs_;
   std::vector<AtlasPage> pages_;
+
+  GLProcs *gl_{};
+  GLint max_layers_{};
+  GLuint array_texture_{};
+  std::uint32_t layer_cap_{};
+  std::vector<std::vector<std::uint8_t>> layer_pixels_;
+
+  std::mutex mu_;
+  std::thread::id owner_{std::this_thread::get_id()};
 };
 
 struct GLRenderer final {
@@ -928,6 +1121,10 @@ struct GLRenderer final {
   GLint u_mvp{-1};
   GLint u_tex{-1};
   GLint u_tex_mode{-1};
+  GLint u_glyphs{-1};
+  GLint u_uv_scale{-1};
+  GLint u_transform{-1};
+  GLint u_origin{-1};
   GLint a_pos{-1};
   GLint a_uv{-1};
   GLint a_color{-1};
@@ -939,6 +1136,15 @@ struct GLRenderer final {
   GLuint bound_tex{};
   int use_tex{};
 
+  bool glyph_layers{};
+  const GLTextCache *glyphs{};
+
+  bool offscreen{};
+
+  VertexFormat vertex_format{VertexFormat::Float};
+  std::size_t bytes_uploaded{};
+  std::size_t vertices_uploaded{};
+
   ~GLRenderer() {
     if (gl) {
       if (vbo != 0) {
@@ -953,22 +1159,83 @@ struct GLRenderer final {
     }
   }
 
-  bool init(GLProcs &p) {
+  bool init(GLProcs &p, bool layered_glyphs = false) {
     gl = &p;
     has_vao = gl->has_vao;
 
+    if (layered_glyphs && gl->has_tex_array) {
+      const char *vs_layered =
+          "#version 130\n"
+          "attribute vec2 aPos;\n"
+          "attribute vec2 aUV;\n"
+          "attribute vec4 aColor;\n"
+          "uniform mat4 uMVP;\n"
+          "uniform int uTexMode;\n"
+          "uniform float uUVScale;\n"
+          "uniform vec4 uTransform;\n"
+          "uniform vec2 uOrigin;\n"
+          "varying vec2 vUV;\n"
+          "varying float vLayer;\n"
+          "varying vec4 vColor;\n"
+          "void main() {\n"
+          "  vec2 uv = aUV * uUVScale;\n"
+          "  vLayer = uTexMode == 3 ? floor(uv.x) : 0.0;\n"
+          "  vUV = vec2(uv.x - vLayer, uv.y);\n"
+          "  vColor = vec4(aColor.rgb, aColor.a * uTransform.w);\n"
+          "  vec2 p = uOrigin + (aPos - uOrigin) * uTransform.z + uTransform.xy;\n"
+          "  gl_Position = uMVP * vec4(p, 0.0, 1.0);\n"
+          "}\n";
+
+      const char *fs_layered =
+          "#version 130\n"
+          "uniform sampler2D uTex;\n"
+          "uniform sampler2DArray uGlyphs;\n"
+          "uniform int uTexMode;\n"
+          "varying vec2 vUV;\n"
+          "varying float vLayer;\n"
+          "varying vec4 vColor;\n"
+          "void main() {\n"
+          "  if (uTexMode == 0) {\n"
+          "    gl_FragColor = vColor;\n"
+          "  } else if (uTexMode == 3) {\n"
+          "    float a = texture(uGlyphs, vec3(vUV, vLayer)).a;\n"
+          "    gl_FragColor = vec4(vColor.rgb, vColor.a * a);\n"
+          "  } else if (uTexMode == 1) {\n"
+          "    float a = texture2D(uTex, vUV).a;\n"
+          "    gl_FragColor = vec4(vColor.rgb, vColor.a * a);\n"
+          "  } else {\n"
+          "    vec4 t = texture2D(uTex, vUV);\n"
+          "    gl_FragColor = vec4(vColor.rgb * t.rgb, vColor.a * t.a);\n"
+          "  }\n"
+          "}\n";
+
+      program = build_program(vs_layered, fs_layered);
+      if (program != 0) {
+        u_glyphs = gl->GetUniformLocation(program, "uGlyphs");
+        glyph_layers = u_glyphs >= 0;
+        if (!glyph_layers) {
+          gl->DeleteProgram(program);
+          program = 0;
+        }
+      }
+    }
+
     const char *vs_src =
         "#version 120\n"
         "attribute vec2 aPos;\n"
         "attribute vec2 aUV;\n"
         "attribute vec4 aColor;\n"
         "uniform mat4 uMVP;\n"
+        "uniform float uUVScale;\n"
+        "uniform vec4 uTransform;\n"
+        "uniform vec2 uOrigin;\n"
         "varying vec2 vUV;\n"
         "varying vec4 vColor;\n"
         "void main() {\n"
-        "  vUV = aUV;\n"
-        "  vColor = aColor;\n"
-        "  gl_Position = uMVP * vec4(aPos, 0.0, 1.0);\n"
+        "  vUV = aUV * uUVScale;\n"
+        "  vColor = vec4(aColor.rgb, aColor.a * uTransform.w);\n"
+        "  vec2 p = uOrigin + (aPos - uOrigin) * uTransform.z + uTransform.xy;\n"
+        "  gl_Position = uMVP * vec4(p, 0.0, 1.0);\n"
         "}\n";
 
     const char *fs_src =
@@ -989,21 +1256,9 @@ struct GLRenderer final {
         "  }\n"
         "}\n";
 
-    const GLuint vs = duorou_compile_shader(*gl, GL_VERTEX_SHADER, vs_src);
-    const GLuint fs = duorou_compile_shader(*gl, GL_FRAGMENT_SHADER, fs_src);
-    if (vs == 0 || fs == 0) {
-      if (vs != 0) {
-        gl->DeleteShader(vs);
-      }
-      if (fs != 0) {
-        gl->DeleteShader(fs);
-      }
-      return false;
+    if (program == 0) {
+      program = build_program(vs_src, fs_src);
     }
-
-    program = duorou_link_program(*gl, vs, fs);
-    gl->DeleteShader(vs);
-    gl->DeleteShader(fs);
     if (program == 0) {
       return false;
     }
@@ -1011,11 +1266,14 @@ struct GLRenderer final {
     u_mvp = gl->GetUniformLocation(program, "uMVP");
     u_tex = gl->GetUniformLocation(program, "uTex");
     u_tex_mode = gl->GetUniformLocation(program, "uTexMode");
+    u_uv_scale = gl->GetUniformLocation(program, "uUVScale");
+    u_transform = gl->GetUniformLocation(program, "uTransform");
+    u_origin = gl->GetUniformLocation(program, "uOrigin");
     a_pos = gl->GetAttribLocation(program, "aPos");
     a_uv = gl->GetAttribLocation(program, "aUV");
     a_color = gl->GetAttribLocation(program, "aColor");
-    if (u_mvp < 0 || u_tex < 0 || u_tex_mode < 0 || a_pos < 0 || a_uv < 0 ||
-        a_color < 0) {
+    if (u_mvp < 0 || u_tex < 0 || u_tex_mode < 0 || u_uv_scale < 0 ||
+        u_transform < 0 || u_origin < 0 || a_pos < 0 || a_uv < 0 || a_color < 0) {
       return false;
     }
 
@@ -1047,14 +1305,27 @@ struct GLRenderer final {
     glViewport(0, 0, w, h);
 
     gl->UseProgram(program);
-    float mvp[16]{};
-    duorou_ortho_px(w, h, mvp);
-    gl->UniformMatrix4fv(u_mvp, 1, GL_FALSE, mvp);
+    duorou_ortho_px(w, h, mvp_);
+    gl->UniformMatrix4fv(u_mvp, 1, GL_FALSE, mvp_);
+    gl->Uniform1f(u_uv_scale, 1.0f);
+    gl->Uniform4f(u_transform, 0.0f, 0.0f, 1.0f, 1.0f);
+    gl->Uniform2f(u_origin, 0.0f, 0.0f);
+    pos_scale_ = 1.0f;
+    uv_scale_ = 1.0f;
+    transform_ = 0;
     gl->ActiveTexture(GL_TEXTURE0);
     gl->Uniform1i(u_tex, 0);
+    if (glyph_layers) {
+      gl->Uniform1i(u_glyphs, 1);
+    }
 
     glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    if (offscreen) {
+      gl->BlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE,
+                            GL_ONE_MINUS_SRC_ALPHA);
+    } else {
+      glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    }
     glDisable(GL_CULL_FACE);
     glDisable(GL_DEPTH_TEST);
     glEnable(GL_SCISSOR_TEST);
@@ -1070,7 +1341,7 @@ struct GLRenderer final {
       gl->BindVertexArray(vao);
     } else {
       gl->BindBuffer(GL_ARRAY_BUFFER, vbo);
-      setup_attribs();
+      setup_attribs(attrib_format_);
     }
   }
 
@@ -1087,7 +1358,10 @@ struct GLRenderer final {
     gl->UseProgram(0);
   }
 
-  void draw_tree(const RenderTree &tree) {
+  void draw_tree(const RenderTree &tree) { draw_tree(tree, {}); }
+
+  void draw_tree(const RenderTree &tree,
+                 const std::vector<RenderTransform> &transforms) {
     if (!gl) {
       return;
     }
@@ -1096,29 +1370,70 @@ struct GLRenderer final {
     }
 
     gl->BindBuffer(GL_ARRAY_BUFFER, vbo);
-    const auto bytes =
-        static_cast<std::ptrdiff_t>(tree.vertices.size() * sizeof(RenderVertex));
-    gl->BufferData(GL_ARRAY_BUFFER, bytes, tree.vertices.data(), GL_STREAM_DRAW);
+    const bool compact = vertex_format == VertexFormat::Compact &&
+                         compact_vertices(tree.vertices, compact_);
+    if (compact) {
+      const auto bytes = static_cast<std::ptrdiff_t>(
+          compact_.vertices.size() * sizeof(CompactVertex));
+      gl->BufferData(GL_ARRAY_BUFFER, bytes, compact_.vertices.data(),
+                     GL_STREAM_DRAW);
+      bytes_uploaded += static_cast<std::size_t>(bytes);
+      set_vertex_scale(compact_.pos_scale, compact_.uv_scale);
+    } else {
+      const auto bytes = static_cast<std::ptrdiff_t>(tree.vertices.size() *
+                                                     sizeof(RenderVertex));
+      gl->BufferData(GL_ARRAY_BUFFER, bytes, tree.vertices.data(),
+                     GL_STREAM_DRAW);
+      bytes_uploaded += static_cast<std::size_t>(bytes);
+      set_vertex_scale(1.0f, 1.0f);
+    }
+    vertices_uploaded += tree.vertices.size();
+    const auto format = compact ? VertexFormat::Compact : VertexFormat::Float;
+    if (format != attrib_format_) {
+      setup_attribs(format);
+    }
 
     RectF last_scissor{};
     bool has_last_scissor = false;
 
     GLuint last_tex = bound_tex;
     int last_use_tex = use_tex;
+    bool premultiplied = false;
+
+    const GLuint glyph_array =
+        glyph_layers && glyphs ? glyphs->array_texture() : 0;
+    if (glyph_array != 0) {
+      gl->ActiveTexture(GL_TEXTURE1);
+      glBindTexture(GL_TEXTURE_2D_ARRAY, glyph_array);
+      gl->ActiveTexture(GL_TEXTURE0);
+    }
 
     for (const auto &b : tree.batches) {
       if (b.count == 0) {
         continue;
       }
 
-      if (!has_last_scissor || b.scissor.x != last_scissor.x ||
-          b.scissor.y != last_scissor.y || b.scissor.w != last_scissor.w ||
-          b.scissor.h != last_scissor.h) {
-        apply_scissor(b.scissor);
-        last_scissor = b.scissor;
+      if (b.transform != transform_) {
+        set_transform(tree, b, transforms, compact ? compact_.pos_scale : 1.0f);
+      }
+      const RectF sc = batch_scissor(tree, b, transforms);
+      if (!has_last_scissor || sc.x != last_scissor.x ||
+          sc.y != last_scissor.y || sc.w != last_scissor.w ||
+          sc.h != last_scissor.h) {
+        apply_scissor(sc);
+        last_scissor = sc;
         has_last_scissor = true;
       }
 
+      if (!offscreen && premultiplied != (b.pipeline == RenderPipeline::Layer)) {
+        premultiplied = b.pipeline == RenderPipeline::Layer;
+        if (premultiplied) {
+          glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+        } else {
+          glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        }
+      }
+
       if (b.pipeline == RenderPipeline::Color) {
         if (last_use_tex != 0) {
           gl->Uniform1i(u_tex_mode, 0);
@@ -1130,6 +1445,15 @@ struct GLRenderer final {
         }
       } else if (b.pipeline == RenderPipeline::Text) {
         const auto tex = static_cast<GLuint>(b.texture);
+        if (tex != 0 && tex == glyph_array) {
+          if (last_use_tex != 3) {
+            gl->Uniform1i(u_tex_mode, 3);
+            last_use_tex = 3;
+          }
+          glDrawArrays(GL_TRIANGLES, static_cast<GLint>(b.first),
+                       static_cast<GLsizei>(b.count));
+          continue;
+        }
         if (last_use_tex != 1) {
           gl->Uniform1i(u_tex_mode, 1);
           last_use_tex = 1;
@@ -1154,11 +1478,38 @@ struct GLRenderer final {
                    static_cast<GLsizei>(b.count));
     }
 
+    if (premultiplied) {
+      glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    }
+    if (transform_ != 0) {
+      gl->Uniform4f(u_transform, 0.0f, 0.0f, 1.0f, 1.0f);
+      transform_ = 0;
+    }
+
     use_tex = last_use_tex;
     bound_tex = last_tex;
   }
 
 private:
+  GLuint build_program(const char *vs_src, const char *fs_src) {
+    const GLuint vs = duorou_compile_shader(*gl, GL_VERTEX_SHADER, vs_src);
+    const GLuint fs = duorou_compile_shader(*gl, GL_FRAGMENT_SHADER, fs_src);
+    if (vs == 0 || fs == 0) {
+      if (vs != 0) {
+        gl->DeleteShader(vs);
+      }
+      if (fs != 0) {
+        gl->DeleteShader(fs);
+      }
+      return 0;
+    }
+
+    const GLuint prog = duorou_link_program(*gl, vs, fs);
+    gl->DeleteShader(vs);
+    gl->DeleteShader(fs);
+    return prog;
+  }
+
   void apply_scissor(RectF r) {
     int x0 = static_cast<int>(std::floor(r.x));
     int y0 = static_cast<int>(std::floor(r.y));
@@ -1176,11 +1527,57 @@ private:
     glScissor(x0, sc_y, w, h);
   }
 
-  void setup_attribs() {
+  void set_vertex_scale(float pos_scale, float uv_scale) {
+    if (pos_scale != pos_scale_) {
+      float mvp[16];
+      std::copy(std::begin(mvp_), std::end(mvp_), mvp);
+      for (int i = 0; i < 8; ++i) {
+        mvp[i] *= pos_scale;
+      }
+      gl->UniformMatrix4fv(u_mvp, 1, GL_FALSE, mvp);
+      pos_scale_ = pos_scale;
+    }
+    if (uv_scale != uv_scale_) {
+      gl->Uniform1f(u_uv_scale, uv_scale);
+      uv_scale_ = uv_scale;
+    }
+  }
+
+  void set_transform(const RenderTree &tree, const RenderBatch &b,
+                     const std::vector<RenderTransform> &transforms,
+                     float pos_scale) {
+    transform_ = b.transform;
+    const auto *g = batch_transform_group(tree, b);
+    if (!g) {
+      gl->Uniform4f(u_transform, 0.0f, 0.0f, 1.0f, 1.0f);
+      return;
+    }
+    const auto t = batch_transform(tree, b, transforms);
+    gl->Uniform4f(u_transform, t.dx / pos_scale, t.dy / pos_scale, t.scale,
+                  std::clamp(t.opacity, 0.0f, 1.0f));
+    gl->Uniform2f(u_origin, g->origin_x / pos_scale, g->origin_y / pos_scale);
+  }
+
+  void setup_attribs(VertexFormat format = VertexFormat::Float) {
+    attrib_format_ = format;
     gl->EnableVertexAttribArray(static_cast<GLuint>(a_pos));
     gl->EnableVertexAttribArray(static_cast<GLuint>(a_uv));
     gl->EnableVertexAttribArray(static_cast<GLuint>(a_color));
 
+    if (format == VertexFormat::Compact) {
+      const auto stride = static_cast<GLsizei>(sizeof(CompactVertex));
+      gl->VertexAttribPointer(
+          static_cast<GLuint>(a_pos), 2, GL_SHORT, GL_FALSE, stride,
+          reinterpret_cast<const void *>(offsetof(CompactVertex, x)));
+      gl->VertexAttribPointer(
+          static_cast<GLuint>(a_uv), 2, GL_UNSIGNED_SHORT, GL_TRUE, stride,
+          reinterpret_cast<const void *>(offsetof(CompactVertex, u)));
+      gl->VertexAttribPointer(
+          static_cast<GLuint>(a_color), 4, GL_UNSIGNED_BYTE, GL_TRUE, stride,
+          reinterpret_cast<const void *>(offsetof(CompactVertex, rgba)));
+      return;
+    }
+
     gl->VertexAttribPointer(static_cast<GLuint>(a_pos), 2, GL_FLOAT, GL_FALSE,
                             static_cast<GLsizei>(sizeof(RenderVertex)),
                             reinterpret_cast<const void *>(
@@ -1194,13 +1591,292 @@ private:
         static_cast<GLsizei>(sizeof(RenderVertex)),
         reinterpret_cast<const void *>(offsetof(RenderVertex, rgba)));
   }
+
+  float mvp_[16]{};
+  float pos_scale_{1.0f};
+  float uv_scale_{1.0f};
+  VertexFormat attrib_format_{VertexFormat::Float};
+  CompactVertices compact_{};
+  std::uint32_t transform_{};
+};
+
+class GLLayerCache {
+public:
+  struct Stats {
+    std::size_t hits{};
+    std::size_t misses{};
+    std::size_t inlined{};
+    std::size_t evictions{};
+    std::size_t layers{};
+    std::size_t bytes{};
+  };
+
+  GLLayerCache() = default;
+  GLLayerCache(const GLLayerCache &) = delete;
+  GLLayerCache &operator=(const GLLayerCache &) = delete;
+
+  ~GLLayerCache() {
+    for (auto &kv : entries_) {
+      release(kv.second);
+    }
+  }
+
+  bool init(GLProcs &gl, std::size_t budget_bytes) {
+    if (!gl.has_fbo) {
+      return false;
+    }
+    gl_ = &gl;
+    budget_ = budget_bytes;
+    return true;
+  }
+
+  const Stats &stats() const { return stats_; }
+
+  void reset_stats() {
+    const auto layers = stats_.layers;
+    const auto bytes = stats_.bytes;
+    stats_ = Stats{};
+    stats_.layers = layers;
+    stats_.bytes = bytes;
+  }
+
+  std::vector<RenderOp> resolve(const std::vector<RenderOp> &ops,
+                                TextProvider &text, GLRenderer &renderer) {
+    ++frame_;
+    std::vector<RenderOp> out;
+    out.reserve(ops.size());
+    for (std::size_t i = 0; i < ops.size(); ++i) {
+      const auto *pl = std::get_if<PushLayer>(&ops[i]);
+      if (!pl) {
+        if (!std::holds_alternative<PopLayer>(ops[i])) {
+          out.push_back(ops[i]);
+        }
+        continue;
+      }
+
+      std::size_t end = i + 1;
+      for (int depth = 1; end < ops.size(); ++end) {
+        if (std::holds_alternative<PushLayer>(ops[end])) {
+          ++depth;
+        } else if (std::holds_alternative<PopLayer>(ops[end]) && --depth == 0) {
+          break;
+        }
+      }
+
+      if (!gl_ || !composite(*pl, ops, i + 1, end, text, renderer, out)) {
+        ++stats_.inlined;
+        for (std::size_t k = i + 1; k < end; ++k) {
+          if (!std::holds_alternative<PushLayer>(ops[k]) &&
+              !std::holds_alternative<PopLayer>(ops[k])) {
+            out.push_back(ops[k]);
+          }
+        }
+      }
+      i = end;
+    }
+
+    for (auto it = entries_.begin(); it != entries_.end();) {
+      if (frame_ - it->second.last_frame > 120) {
+        release(it->second);
+        it = entries_.erase(it);
+        ++stats_.evictions;
+      } else {
+        ++it;
+      }
+    }
+    return out;
+  }
+
+private:
+  struct Entry {
+    GLuint fbo{};
+    GLuint texture{};
+    int w{};
+    int h{};
+    std::uint64_t generation{};
+    std::uint64_t last_frame{};
+  };
+
+  static std::size_t entry_bytes(int w, int h) {
+    return static_cast<std::size_t>(w) * static_cast<std::size_t>(h) * 4u;
+  }
+
+  void release(Entry &e) {
+    if (e.fbo != 0) {
+      gl_->DeleteFramebuffers(1, &e.fbo);
+      e.fbo = 0;
+    }
+    if (e.texture != 0) {
+      glDeleteTextures(1, &e.texture);
+      e.texture = 0;
+    }
+    if (e.w > 0 && e.h > 0) {
+      stats_.bytes -= entry_bytes(e.w, e.h);
+      --stats_.layers;
+    }
+    e.w = 0;
+    e.h = 0;
+  }
+
+  bool make_room(std::size_t bytes) {
+    while (stats_.bytes + bytes > budget_) {
+      auto victim = entries_.end();
+      for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+        if (it->second.last_frame == frame_) {
+          continue;
+        }
+        if (victim == entries_.end() ||
+            it->second.last_frame < victim->second.last_frame) {
+          victim = it;
+        }
+      }
+      if (victim == entries_.end()) {
+        return false;
+      }
+      release(victim->second);
+      entries_.erase(victim);
+      ++stats_.evictions;
+    }
+    return true;
+  }
+
+  bool allocate(Entry &e, int w, int h) {
+    glGenTextures(1, &e.texture);
+    gl_->GenFramebuffers(1, &e.fbo);
+    if (e.texture == 0 || e.fbo == 0) {
+      release(e);
+      return false;
+    }
+    glBindTexture(GL_TEXTURE_2D, e.texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                 nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    gl_->BindFramebuffer(GL_FRAMEBUFFER, e.fbo);
+    gl_->FramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                              GL_TEXTURE_2D, e.texture, 0);
+    const bool complete =
+        gl_->CheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    gl_->BindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    e.w = w;
+    e.h = h;
+    stats_.bytes += entry_bytes(w, h);
+    ++stats_.layers;
+    if (!complete) {
+      release(e);
+      return false;
+    }
+    return true;
+  }
+
+  bool composite(const PushLayer &pl, const std::vector<RenderOp> &ops,
+                 std::size_t first, std::size_t last, TextProvider &text,
+                 GLRenderer &renderer, std::vector<RenderOp> &out) {
+    if (pl.generation == 0) {
+      return false;
+    }
+    const float x0 = std::floor(pl.rect.x);
+    const float y0 = std::floor(pl.rect.y);
+    const int w = static_cast<int>(std::ceil(pl.rect.x + pl.rect.w) - x0);
+    const int h = static_cast<int>(std::ceil(pl.rect.y + pl.rect.h) - y0);
+    if (w <= 0 || h <= 0 || entry_bytes(w, h) > budget_) {
+      return false;
+    }
+
+    auto it = entries_.find(pl.id);
+    if (it != entries_.end() && (it->second.w != w || it->second.h != h)) {
+      release(it->second);
+      entries_.erase(it);
+      it = entries_.end();
+    }
+
+    if (it != entries_.end() && it->second.generation == pl.generation) {
+      ++stats_.hits;
+    } else {
+      if (it == entries_.end()) {
+        if (!make_room(entry_bytes(w, h))) {
+          return false;
+        }
+        Entry e{};
+        if (!allocate(e, w, h)) {
+          return false;
+        }
+        it = entries_.emplace(pl.id, e).first;
+      }
+      ++stats_.misses;
+
+      std::vector<RenderOp> sub;
+      sub.reserve(last - first);
+      for (std::size_t k = first; k < last; ++k) {
+        auto op = ops[k];
+        std::visit(
+            [&](auto &v) {
+              using T = std::decay_t<decltype(v)>;
+              if constexpr (std::is_same_v<T, PushClip> ||
+                            std::is_same_v<T, DrawRect> ||
+                            std::is_same_v<T, DrawText> ||
+                            std::is_same_v<T, DrawImage>) {
+                v.rect.x -= x0;
+                v.rect.y -= y0;
+              }
+            },
+            op);
+        sub.push_back(std::move(op));
+      }
+
+      gl_->BindFramebuffer(GL_FRAMEBUFFER, it->second.fbo);
+      glViewport(0, 0, w, h);
+      glDisable(GL_SCISSOR_TEST);
+      glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+      glClear(GL_COLOR_BUFFER_BIT);
+      renderer.offscreen = true;
+      renderer.begin_frame(w, h);
+      const auto tree = build_render_tree(
+          sub, SizeF{static_cast<float>(w), static_cast<float>(h)}, text);
+      renderer.draw_tree(tree);
+      renderer.end_frame();
+      renderer.offscreen = false;
+      gl_->BindFramebuffer(GL_FRAMEBUFFER, 0);
+      glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+      it->second.generation = pl.generation;
+    }
+
+    it->second.last_frame = frame_;
+    DrawImage img;
+    img.rect = RectF{x0, y0, static_cast<float>(w), static_cast<float>(h)};
+    img.texture = static_cast<TextureHandle>(it->second.texture);
+    img.uv = RectF{0.0f, 1.0f, 1.0f, -1.0f};
+    img.premultiplied = true;
+    out.push_back(img);
+    return true;
+  }
+
+  GLProcs *gl_{};
+  std::size_t budget_{};
+  std::uint64_t frame_{};
+  std::unordered_map<std::uint64_t, Entry> entries_;
+  Stats stats_{};
 };
 
 struct InputCtx {
   ViewInstance *app{};
+  InputQueue *queue{};
   int pointer_id{1};
 };
 
+static void input_emit(InputCtx &ctx, InputEvent e) {
+  if (ctx.queue) {
+    ctx.queue->push(std::move(e));
+    return;
+  }
+  dispatch_input(*ctx.app, e);
+}
+
 static void utf8_append(std::string &out, std::uint32_t cp) {
   if (cp <= 0x7F) {
     out.push_back(static_cast<char>(cp));
@@ -1342,9 +2018,12 @@ static void cursor_pos_cb(GLFWwindow *win, double xpos, double ypos) {
   const double sy =
       wh > 0 ? static_cast<double>(fbh) / static_cast<double>(wh) : 1.0;
 
-  const float x = static_cast<float>(xpos * sx);
-  const float y = static_cast<float>(ypos * sy);
-  ctx->app->dispatch_pointer_move(ctx->pointer_id, x, y);
+  InputEvent e;
+  e.kind = InputEventKind::PointerMove;
+  e.pointer = ctx->pointer_id;
+  e.x = static_cast<float>(xpos * sx);
+  e.y = static_cast<float>(ypos * sy);
+  input_emit(*ctx, std::move(e));
 }
 
 static void mouse_button_cb(GLFWwindow *win, int button, int action, int mods) {
@@ -1373,13 +2052,17 @@ static void mouse_button_cb(GLFWwindow *win, int button, int action, int mods) {
   const double sy =
       wh > 0 ? static_cast<double>(fbh) / static_cast<double>(wh) : 1.0;
 
-  const float x = static_cast<float>(xpos * sx);
-  const float y = static_cast<float>(ypos * sy);
+  InputEvent e;
+  e.pointer = ctx->pointer_id;
+  e.x = static_cast<float>(xpos * sx);
+  e.y = static_cast<float>(ypos * sy);
 
   if (action == GLFW_PRESS) {
-    ctx->app->dispatch_pointer_down(ctx->pointer_id, x, y);
+    e.kind = InputEventKind::PointerDown;
+    input_emit(*ctx, std::move(e));
   } else if (action == GLFW_RELEASE) {
-    ctx->app->dispatch_pointer_up(ctx->pointer_id, x, y);
+    e.kind = InputEventKind::PointerUp;
+    input_emit(*ctx, std::move(e));
   }
 }
 
@@ -1405,11 +2088,13 @@ static void scroll_cb(GLFWwindow *win, double xoffset, double yoffset) {
   const double sy =
       wh > 0 ? static_cast<double>(fbh) / static_cast<double>(wh) : 1.0;
 
-  const float x = static_cast<float>(xpos * sx);
-  const float y = static_cast<float>(ypos * sy);
-
   const float wheel_px = 40.0f;
-  ctx->app->dispatch_scroll(x, y, static_cast<float>(-yoffset) * wheel_px);
+  InputEvent e;
+  e.kind = InputEventKind::Scroll;
+  e.x = static_cast<float>(xpos * sx);
+  e.y = static_cast<float>(ypos * sy);
+  e.delta = static_cast<float>(-yoffset) * wheel_px;
+  input_emit(*ctx, std::move(e));
 }
 
 static void key_cb(GLFWwindow *win, int key, int scancode, int action,
@@ -1418,10 +2103,16 @@ static void key_cb(GLFWwindow *win, int key, int scancode, int action,
   if (!ctx || !ctx->app) {
     return;
   }
+  InputEvent e;
+  e.key = key;
+  e.scancode = scancode;
+  e.mods = mods;
   if (action == GLFW_PRESS || action == GLFW_REPEAT) {
-    ctx->app->dispatch_key_down(key, scancode, mods);
+    e.kind = InputEventKind::KeyDown;
+    input_emit(*ctx, std::move(e));
   } else if (action == GLFW_RELEASE) {
-    ctx->app->dispatch_key_up(key, scancode, mods);
+    e.kind = InputEventKind::KeyUp;
+    input_emit(*ctx, std::move(e));
   }
 }
 
@@ -1433,7 +2124,10 @@ static void char_cb(GLFWwindow *win, unsigned int codepoint) {
   std::string text;
   utf8_append(text, static_cast<std::uint32_t>(codepoint));
   if (!text.empty()) {
-    ctx->app->dispatch_text_input(std::move(text));
+    InputEvent e;
+    e.kind = InputEventKind::TextInput;
+    e.text = std::move(text);
+    input_emit(*ctx, std::move(e));
   }
 }
 
@@ -1441,6 +2135,11 @@ int main(int argc, char **argv) {
   bool use_terminal = false;
   bool use_nav = false;
   bool use_editor = false;
+  bool glyph_pages = false;
+  bool show_stats = false;
+  bool pipelined = false;
+  bool occlusion = false;
+  bool use_compact_vertices = false;
 #if defined(DUOROU_EDITOR_DEFAULT)
   use_editor = true;
 #endif
@@ -1460,6 +2159,21 @@ int main(int argc, char **argv) {
     if (std::strcmp(arg, "--editor") == 0 || std::strcmp(arg, "editor") == 0) {
       use_editor = true;
     }
+    if (std::strcmp(arg, "--glyph-pages") == 0) {
+      glyph_pages = true;
+    }
+    if (std::strcmp(arg, "--stats") == 0) {
+      show_stats = true;
+    }
+    if (std::strcmp(arg, "--pipeline") == 0) {
+      pipelined = true;
+    }
+    if (std::strcmp(arg, "--occlusion") == 0) {
+      occlusion = true;
+    }
+    if (std::strcmp(arg, "--compact-vertices") == 0) {
+      use_compact_vertices = true;
+    }
   }
 
   if (!glfwInit()) {
@@ -1495,11 +2209,14 @@ int main(int argc, char **argv) {
   }
 
   GLRenderer renderer;
-  if (!renderer.init(gl)) {
+  if (!renderer.init(gl, !glyph_pages)) {
     glfwDestroyWindow(win);
     glfwTerminate();
     return 1;
   }
+  if (use_compact_vertices) {
+    renderer.vertex_format = VertexFormat::Compact;
+  }
 
   GLuint demo_tex = duorou_make_demo_rgba_texture();
   const TextureHandle demo_tex_handle = static_cast<TextureHandle>(demo_tex);
@@ -1545,6 +2262,13 @@ int main(int argc, char **argv) {
       std::make_shared<duorou::ui::dsl::MiniSwiftEngine>()};
 
   GLTextCache text_cache;
+  if (renderer.glyph_layers) {
+    text_cache.enable_layers(gl);
+  }
+  renderer.glyphs = &text_cache;
+
+  GLLayerCache layer_cache;
+  const bool use_layers = layer_cache.init(gl, 64u * 1024u * 1024u);
 
   ViewInstance app{[&]() {
     provide_environment_object<duorou::ui::dsl::Engine>("dsl.engine", dsl_engine);
@@ -2709,25 +3433,19 @@ int main(int argc, char **argv) {
         if (!e) {
           return false;
         }
-        out.w = static_cast<float>(e->w);
-        out.h = static_cast<float>(e->h);
-        out.quads.reserve(e->quads.size());
-        for (const auto &q : e->quads) {
-          TextQuad tq;
-          tq.x0 = q.x0;
-          tq.y0 = q.y0;
-          tq.x1 = q.x1;
-          tq.y1 = q.y1;
-          tq.u0 = q.u0;
-          tq.v0 = q.v0;
-          tq.u1 = q.u1;
-          tq.v1 = q.v1;
-          tq.texture = static_cast<TextureHandle>(q.texture);
-          out.quads.push_back(tq);
-        }
+        out.w = e->w;
+        out.h = e->h;
+        out.quads = e->quads;
         out.caret_x = e->caret_x;
         return true;
       }
+
+      const TextLayout *layout_run(std::uint64_t hash, std::string_view text,
+                                   float font_px) override {
+        return cache ? cache->get(hash, text, font_px) : nullptr;
+      }
+
+      bool stable_runs() const override { return true; }
     };
 
     GLTextProvider text;
@@ -2736,36 +3454,206 @@ int main(int argc, char **argv) {
     int last_fbw = 0;
     int last_fbh = 0;
 
-    while (!glfwWindowShouldClose(win)) {
-      glfwPollEvents();
-
-      int fbw = 0;
-      int fbh = 0;
-      glfwGetFramebufferSize(win, &fbw, &fbh);
-      fbw = std::max(1, fbw);
-      fbh = std::max(1, fbh);
-
-      if (fbw != last_fbw || fbh != last_fbh) {
-        app.set_viewport(
-            SizeF{static_cast<float>(fbw), static_cast<float>(fbh)});
-        last_fbw = fbw;
-        last_fbh = fbh;
+    double stats_t0 = glfwGetTime();
+    double stats_cpu_ms = 0.0;
+    int stats_frames = 0;
+    std::size_t stats_ops_emitted = 0;
+    std::size_t stats_ops_reused = 0;
+    std::size_t stats_nodes_culled = 0;
+    std::size_t stats_ops_culled = 0;
+    std::size_t stats_ops_occluded = 0;
+    std::size_t stats_duplicate_keys = 0;
+    FrameLatency latency;
+
+    ThreadPool tree_pool;
+
+    auto draw_frame = [&](const auto &frame,
+                          const std::vector<RenderTransform> &transforms,
+                          int fbw, int fbh) {
+      const SizeF viewport{static_cast<float>(fbw), static_cast<float>(fbh)};
+      RenderTree tree;
+      if constexpr (std::is_same_v<std::decay_t<decltype(frame)>,
+                                   RenderCommandBuffer>) {
+        if (use_layers && frame.has_layers()) {
+          tree = build_render_tree(
+              layer_cache.resolve(frame.to_ops(), text, renderer), viewport,
+              text, tree_pool);
+        } else {
+          if (use_layers) {
+            layer_cache.resolve({}, text, renderer);
+          }
+          tree = build_render_tree(frame, viewport, text, tree_pool);
+        }
+      } else if (use_layers) {
+        tree = build_render_tree(layer_cache.resolve(frame, text, renderer),
+                                 viewport, text, tree_pool);
+      } else {
+        tree = build_render_tree(frame, viewport, text, tree_pool);
       }
 
-      app.update();
-
       glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
       glClear(GL_COLOR_BUFFER_BIT);
 
       renderer.begin_frame(fbw, fbh);
-      const auto tree = build_render_tree(
-          app.render_ops(), SizeF{static_cast<float>(fbw), static_cast<float>(fbh)},
-          text);
-      renderer.draw_tree(tree);
+      renderer.draw_tree(tree, transforms);
       renderer.end_frame();
+    };
+
+    auto report_stats = [&](double frame_t0) {
+      const double t = glfwGetTime();
+      ++stats_frames;
+      stats_cpu_ms += (t - frame_t0) * 1000.0;
+      if (t - stats_t0 < 1.0) {
+        return;
+      }
+      const auto &ls = layer_cache.stats();
+      std::fprintf(stderr,
+                   "frames=%d avg_ms=%.2f layers=%zu layer_kb=%zu "
+                   "layer_hits=%zu layer_misses=%zu layer_inlined=%zu "
+                   "ops_emitted=%zu ops_reused=%zu nodes_culled=%zu "
+                   "ops_culled=%zu ops_occluded=%zu duplicate_keys=%zu "
+                   "vertex_format=%s upload_kb=%.1f",
+                   stats_frames, stats_cpu_ms / stats_frames, ls.layers,
+                   ls.bytes / 1024u, ls.hits, ls.misses, ls.inlined,
+                   stats_ops_emitted, stats_ops_reused, stats_nodes_culled,
+                   stats_ops_culled, stats_ops_occluded, stats_duplicate_keys,
+                   renderer.vertex_format == VertexFormat::Compact ? "compact"
+                                                                   : "float",
+                   static_cast<double>(renderer.bytes_uploaded) / 1024.0 /
+                       stats_frames);
+      if (pipelined) {
+        std::fprintf(stderr,
+                     " ui_ms=%.2f queue_ms=%.2f input_latency_ms=%.2f "
+                     "input_latency_max_ms=%.2f",
+                     latency.avg_build_ms(), latency.avg_queue_ms(),
+                     latency.avg_input_ms(), latency.max_input_ms);
+      }
+      std::fprintf(stderr, "\n");
+      layer_cache.reset_stats();
+      latency.reset();
+      renderer.bytes_uploaded = 0;
+      renderer.vertices_uploaded = 0;
+      stats_frames = 0;
+      stats_cpu_ms = 0.0;
+      stats_t0 = t;
+    };
+
+    InputQueue input_queue;
+    input.queue = &input_queue;
+    set_ui_wakeup([&input_queue] {
+      glfwPostEmptyEvent();
+      input_queue.wake();
+    });
+    if (!pipelined) {
+      std::vector<InputEvent> scratch;
+      while (!glfwWindowShouldClose(win)) {
+        glfwPollEvents();
+        dispatch_queued_input(app, input_queue, scratch);
+
+        int fbw = 0;
+        int fbh = 0;
+        glfwGetFramebufferSize(win, &fbw, &fbh);
+        fbw = std::max(1, fbw);
+        fbh = std::max(1, fbh);
+
+        if (fbw != last_fbw || fbh != last_fbh) {
+          app.set_viewport(
+              SizeF{static_cast<float>(fbw), static_cast<float>(fbh)});
+          last_fbw = fbw;
+          last_fbh = fbh;
+        }
+
+        const double frame_t0 = glfwGetTime();
+        app.update();
+        draw_frame(app.render_ops(), app.render_transforms(), fbw, fbh);
+        glfwSwapBuffers(win);
+
+        if (show_stats) {
+          stats_ops_emitted = app.render_cache().emitted_nodes;
+          stats_ops_reused = app.render_cache().reused_nodes;
+          stats_nodes_culled = app.render_cache().culled_nodes;
+          stats_ops_culled = app.render_cache().culled_ops;
+          stats_duplicate_keys = app.duplicate_key_count();
+          report_stats(frame_t0);
+        }
+      }
+    } else {
+      BoundedQueue<FrameSnapshotPtr> frames{1};
+
+      std::thread ui_thread{[&]() {
+        set_ui_thread();
+        std::vector<InputEvent> scratch;
+        FrameSnapshotPool pool;
+        for (std::uint64_t n = 1;;) {
+          auto s = produce_frame(app, input_queue, scratch, n, pool, occlusion);
+          if (!s) {
+            if (frames.closed()) {
+              break;
+            }
+            input_queue.wait_for(std::chrono::milliseconds{8});
+            continue;
+          }
+          if (!frames.push(std::move(s))) {
+            break;
+          }
+          ++n;
+        }
+      }};
+
+      FrameSnapshotPtr current;
+      while (!glfwWindowShouldClose(win)) {
+        glfwPollEvents();
+
+        int fbw = 0;
+        int fbh = 0;
+        glfwGetFramebufferSize(win, &fbw, &fbh);
+        fbw = std::max(1, fbw);
+        fbh = std::max(1, fbh);
+
+        if (fbw != last_fbw || fbh != last_fbh) {
+          InputEvent e;
+          e.kind = InputEventKind::Resize;
+          e.x = static_cast<float>(fbw);
+          e.y = static_cast<float>(fbh);
+          input_queue.push(std::move(e));
+          last_fbw = fbw;
+          last_fbh = fbh;
+        }
+
+        FrameSnapshotPtr next;
+        const bool fresh = frames.pop_for(next, std::chrono::milliseconds{50});
+        if (fresh) {
+          current = std::move(next);
+        }
+        if (!current) {
+          continue;
+        }
+
+        const double frame_t0 = glfwGetTime();
+        const double draw_begin = pipeline_now();
+        draw_frame(current->commands, current->transforms, fbw, fbh);
+        glfwSwapBuffers(win);
+
+        if (show_stats) {
+          if (fresh) {
+            latency.record(*current, draw_begin, pipeline_now());
+          }
+          stats_ops_emitted = current->ops_emitted;
+          stats_ops_reused = current->ops_reused;
+          stats_nodes_culled = current->nodes_culled;
+          stats_ops_culled = current->ops_culled;
+          stats_ops_occluded = current->ops_occluded;
+          stats_duplicate_keys = current->duplicate_keys;
+          report_stats(frame_t0);
+        }
+      }
 
-      glfwSwapBuffers(win);
+      frames.close();
+      input_queue.wake();
+      ui_thread.join();
     }
+    set_ui_wakeup({});
+    input.queue = nullptr;
   }
 
   if (demo_tex != 0) {
@@ -21,6 +21,9 @@ static NSString *duorou_msl_source() {
   return @"#include <metal_stdlib>\n"
           "using namespace metal;\n"
           "struct Vertex { packed_float2 pos; packed_float2 uv; uint color; };\n"
+          "struct CompactVertex { short2 pos; ushort2 uv; uint color; };\n"
+          "struct CompactParams { float2 viewport; float pos_scale; float uv_scale; };\n"
+          "struct BatchTransform { float4 t; float2 origin; };\n"
           "static inline float4 unpack_color(uint c) {\n"
           "  float r = float(c & 255u) / 255.0;\n"
           "  float g = float((c >> 8) & 255u) / 255.0;\n"
@@ -31,9 +34,11 @@ static NSString *duorou_msl_source() {
           "struct VSOut { float4 pos [[position]]; float2 uv; float4 color; };\n"
           "vertex VSOut duorou_vertex(const device Vertex* vtx [[buffer(0)]],\n"
           "                           constant float2& viewport [[buffer(1)]],\n"
+          "                           constant BatchTransform& bt [[buffer(2)]],\n"
           "                           uint vid [[vertex_id]]) {\n"
           "  VSOut o;\n"
           "  float2 p = float2(vtx[vid].pos);\n"
+          "  p = bt.origin + (p - bt.origin) * bt.t.z + bt.t.xy;\n"
           "  float vw = max(1.0, viewport.x);\n"
           "  float vh = max(1.0, viewport.y);\n"
           "  float x = (p.x / vw) * 2.0 - 1.0;\n"
@@ -41,6 +46,24 @@ static NSString *duorou_msl_source() {
           "  o.pos = float4(x, y, 0.0, 1.0);\n"
           "  o.uv = float2(vtx[vid].uv);\n"
           "  o.color = unpack_color(vtx[vid].color);\n"
+          "  o.color.a *= bt.t.w;\n"
+          "  return o;\n"
+          "}\n"
+          "vertex VSOut duorou_vertex_compact(const device CompactVertex* vtx [[buffer(0)]],\n"
+          "                                   constant CompactParams& params [[buffer(1)]],\n"
+          "                                   constant BatchTransform& bt [[buffer(2)]],\n"
+          "                                   uint vid [[vertex_id]]) {\n"
+          "  VSOut o;\n"
+          "  float2 p = float2(vtx[vid].pos) * params.pos_scale;\n"
+          "  p = bt.origin + (p - bt.origin) * bt.t.z + bt.t.xy;\n"
+          "  float vw = max(1.0, params.viewport.x);\n"
+          "  float vh = max(1.0, params.viewport.y);\n"
+          "  float x = (p.x / vw) * 2.0 - 1.0;\n"
+          "  float y = 1.0 - (p.y / vh) * 2.0;\n"
+          "  o.pos = float4(x, y, 0.0, 1.0);\n"
+          "  o.uv = float2(vtx[vid].uv) / 65535.0 * params.uv_scale;\n"
+          "  o.color = unpack_color(vtx[vid].color);\n"
+          "  o.color.a *= bt.t.w;\n"
           "  return o;\n"
           "}\n"
           "fragment float4 duorou_fragment_color(VSOut in [[stage_in]]) {\n"
@@ -154,6 +177,10 @@ static id<MTLTexture> duorou_make_text_texture(id<MTLDevice> device,
 @property(nonatomic, strong) id<MTLRenderPipelineState> pipelineColor;
 @property(nonatomic, strong) id<MTLRenderPipelineState> pipelineText;
 @property(nonatomic, strong) id<MTLRenderPipelineState> pipelineImage;
+@property(nonatomic, strong) id<MTLRenderPipelineState> pipelineColorCompact;
+@property(nonatomic, strong) id<MTLRenderPipelineState> pipelineTextCompact;
+@property(nonatomic, strong) id<MTLRenderPipelineState> pipelineImageCompact;
+@property(nonatomic) BOOL compactVertices;
 @property(nonatomic, strong) id<MTLSamplerState> sampler;
 @property(nonatomic, strong)
     NSMutableDictionary<NSString *, id<MTLTexture>> *textCache;
@@ -180,7 +207,9 @@ static id<MTLTexture> duorou_make_text_texture(id<MTLDevice> device,
 
 @end
 
-@implementation DuorouMetalView
+@implementation DuorouMetalView {
+  CompactVertices _compact;
+}
 
 - (instancetype)initWithFrame:(NSRect)frameRect
                        device:(id<MTLDevice>)device
@@ -255,6 +284,24 @@ static id<MTLTexture> duorou_make_text_texture(id<MTLDevice> device,
     NSLog(@"Failed to create image pipeline: %@", err);
   }
 
+  id<MTLFunction> vtxCompact = [lib newFunctionWithName:@"duorou_vertex_compact"];
+  descColor.vertexFunction = vtxCompact;
+  descTex.vertexFunction = vtxCompact;
+  descImg.vertexFunction = vtxCompact;
+  self.pipelineColorCompact =
+      [device newRenderPipelineStateWithDescriptor:descColor error:&err];
+  self.pipelineTextCompact =
+      [device newRenderPipelineStateWithDescriptor:descTex error:&err];
+  self.pipelineImageCompact =
+      [device newRenderPipelineStateWithDescriptor:descImg error:&err];
+  if (!self.pipelineColorCompact || !self.pipelineTextCompact ||
+      !self.pipelineImageCompact) {
+    NSLog(@"Failed to create compact vertex pipelines: %@", err);
+    self.pipelineColorCompact = nil;
+    self.pipelineTextCompact = nil;
+    self.pipelineImageCompact = nil;
+  }
+
   MTLSamplerDescriptor *sd = [[MTLSamplerDescriptor alloc] init];
   sd.minFilter = MTLSamplerMinMagFilterLinear;
   sd.magFilter = MTLSamplerMinMagFilterLinear;
@@ -422,13 +469,43 @@ static id<MTLTexture> duorou_make_text_texture(id<MTLDevice> device,
   vpu.w = vw;
   vpu.h = vh;
 
-  if (!tree.vertices.empty()) {
+  struct MetalCompactParams {
+    float w{};
+    float h{};
+    float pos_scale{1.0f};
+    float uv_scale{1.0f};
+  };
+
+  const bool use_compact = self.compactVertices && self.pipelineColorCompact &&
+                           !tree.vertices.empty() &&
+                           compact_vertices(tree.vertices, _compact);
+  if (use_compact) {
+    MetalCompactParams params;
+    params.w = vw;
+    params.h = vh;
+    params.pos_scale = _compact.pos_scale;
+    params.uv_scale = _compact.uv_scale;
+    [enc setVertexBytes:_compact.vertices.data()
+                 length:_compact.vertices.size() * sizeof(CompactVertex)
+                atIndex:0];
+    [enc setVertexBytes:&params length:sizeof(params) atIndex:1];
+  } else if (!tree.vertices.empty()) {
     [enc setVertexBytes:tree.vertices.data()
                  length:tree.vertices.size() * sizeof(RenderVertex)
                 atIndex:0];
     [enc setVertexBytes:&vpu length:sizeof(vpu) atIndex:1];
   }
 
+  struct MetalBatchTransform {
+    float t[4]{0.0f, 0.0f, 1.0f, 1.0f};
+    float origin[2]{};
+    float pad[2]{};
+  };
+  const auto &transforms = self.instance->render_transforms();
+  MetalBatchTransform identity;
+  [enc setVertexBytes:&identity length:sizeof(identity) atIndex:2];
+  std::uint32_t cur_transform = 0;
+
   RenderPipeline cur = RenderPipeline::Color;
   bool has_pipeline = false;
 
@@ -444,23 +521,41 @@ static id<MTLTexture> duorou_make_text_texture(id<MTLDevice> device,
       cur = b.pipeline;
       has_pipeline = true;
       if (cur == RenderPipeline::Color) {
-        [enc setRenderPipelineState:self.pipelineColor];
+        [enc setRenderPipelineState:use_compact ? self.pipelineColorCompact
+                                                : self.pipelineColor];
       } else if (cur == RenderPipeline::Text) {
         if (!self.pipelineText || !self.sampler) {
           continue;
         }
-        [enc setRenderPipelineState:self.pipelineText];
+        [enc setRenderPipelineState:use_compact ? self.pipelineTextCompact
+                                                : self.pipelineText];
         [enc setFragmentSamplerState:self.sampler atIndex:0];
       } else {
         if (!self.pipelineImage || !self.sampler) {
           continue;
         }
-        [enc setRenderPipelineState:self.pipelineImage];
+        [enc setRenderPipelineState:use_compact ? self.pipelineImageCompact
+                                                : self.pipelineImage];
         [enc setFragmentSamplerState:self.sampler atIndex:0];
       }
     }
 
-    [enc setScissorRect:to_scissor(b.scissor)];
+    if (b.transform != cur_transform) {
+      cur_transform = b.transform;
+      MetalBatchTransform bt;
+      if (const auto *g = batch_transform_group(tree, b)) {
+        const auto t = batch_transform(tree, b, transforms);
+        bt.t[0] = t.dx;
+        bt.t[1] = t.dy;
+        bt.t[2] = t.scale;
+        bt.t[3] = std::clamp(t.opacity, 0.0f, 1.0f);
+        bt.origin[0] = g->origin_x;
+        bt.origin[1] = g->origin_y;
+      }
+      [enc setVertexBytes:&bt length:sizeof(bt) atIndex:2];
+    }
+
+    [enc setScissorRect:to_scissor(batch_scissor(tree, b, transforms))];
 
     if (cur == RenderPipeline::Text || cur == RenderPipeline::Image) {
       if (b.texture == 0) {
@@ -556,6 +651,7 @@ static std::unique_ptr<ViewInstance> make_instance(bool use_terminal) {
 
 int main(int argc, const char *argv[]) {
   bool use_terminal = false;
+  bool use_compact_vertices = false;
   for (int i = 1; i < argc; ++i) {
     const char *arg = argv ? argv[i] : nullptr;
     if (!arg) {
@@ -564,6 +660,9 @@ int main(int argc, const char *argv[]) {
     if (std::strcmp(arg, "--terminal") == 0 || std::strcmp(arg, "terminal") == 0) {
       use_terminal = true;
     }
+    if (std::strcmp(arg, "--compact-vertices") == 0) {
+      use_compact_vertices = true;
+    }
   }
 
   @autoreleasepool {
@@ -596,6 +695,7 @@ int main(int argc, const char *argv[]) {
         [[DuorouMetalView alloc] initWithFrame:frame
                                         device:device
                                       instance:instance.get()];
+    view.compactVertices = use_compact_vertices ? YES : NO;
 
     [window setContentView:view];
     [window makeKeyAndOrderFront:nil];
@@ -0,0 +1,296 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include <duorou/ui/render_commands.hpp>
+#include <duorou/ui/runtime.hpp>
+#include <duorou/ui/software_render.hpp>
+
+using namespace duorou::ui;
+
+namespace {
+
+constexpr double kTargetMegapixelsPerSecond = 200.0;
+
+std::vector<RenderOp> dashboard_ops(SizeF viewport) {
+  std::vector<RenderOp> ops;
+  const float card_w = 180.0f;
+  const float card_h = 96.0f;
+  const float gap = 8.0f;
+  int n = 0;
+  for (float y = gap; y + card_h <= viewport.h; y += card_h + gap) {
+    for (float x = gap; x + card_w <= viewport.w; x += card_w + gap, ++n) {
+      const RectF card{x, y, card_w, card_h};
+      ops.emplace_back(PushClip{card});
+      ops.emplace_back(DrawRect{card, ColorU8{40, 44, 52, 255}});
+      DrawText title{};
+      title.rect = RectF{x + 8.0f, y + 6.0f, card_w - 16.0f, 20.0f};
+      title.text = "Metric " + std::to_string(n);
+      title.color = ColorU8{230, 230, 230, 255};
+      title.font_px = 14.0f;
+      title.align_x = 0.0f;
+      ops.emplace_back(std::move(title));
+      for (int i = 0; i < 8; ++i) {
+        const float h = 8.0f + static_cast<float>((n * 7 + i * 13) % 40);
+        ops.emplace_back(DrawRect{RectF{x + 8.0f + static_cast<float>(i) * 20.0f,
+                                        y + card_h - 8.0f - h, 14.0f, h},
+                                  ColorU8{80, 160, 230, 220}});
+      }
+      ops.emplace_back(PopClip{});
+    }
+  }
+  return ops;
+}
+
+bool same_tree(const RenderTree &a, const RenderTree &b) {
+  if (a.vertices.size() != b.vertices.size() ||
+      a.batches.size() != b.batches.size()) {
+    return false;
+  }
+  for (std::size_t i = 0; i < a.vertices.size(); ++i) {
+    const auto &x = a.vertices[i];
+    const auto &y = b.vertices[i];
+    if (x.x != y.x || x.y != y.y || x.u != y.u || x.v != y.v ||
+        x.rgba != y.rgba) {
+      return false;
+    }
+  }
+  for (std::size_t i = 0; i < a.batches.size(); ++i) {
+    const auto &x = a.batches[i];
+    const auto &y = b.batches[i];
+    if (x.pipeline != y.pipeline || x.texture != y.texture ||
+        x.first != y.first || x.count != y.count) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void bench_tree(int iterations, SizeF viewport) {
+  const auto ops = dashboard_ops(viewport);
+  SoftwareRasterizer raster;
+  SoftwareTextProvider text{raster};
+  const auto reference = build_render_tree(ops, viewport, text);
+
+  auto time_ms = [&](auto &&build) {
+    const auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+      build();
+    }
+    const auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(t1 - t0).count() /
+           iterations;
+  };
+
+  const double serial_ms =
+      time_ms([&] { (void)build_render_tree(ops, viewport, text); });
+  std::cout << "tree viewport=" << viewport.w << "x" << viewport.h
+            << " ops=" << ops.size()
+            << " vertices=" << reference.vertices.size()
+            << " batches=" << reference.batches.size()
+            << " serial_ms=" << serial_ms
+            << " hw_threads=" << ThreadPool::default_threads()
+            << (ops.size() < detail::kParallelRenderMinOps ? " parallel=off"
+                                                           : " parallel=on")
+            << "\n";
+
+  RenderCommandBuffer commands;
+  commands.assign(ops);
+  const bool commands_same =
+      same_tree(reference, build_render_tree(commands, viewport, text));
+  const double commands_ms =
+      time_ms([&] { (void)build_render_tree(commands, viewport, text); });
+  std::cout << "commands ms=" << commands_ms
+            << (commands_same ? " identical" : " MISMATCH") << "\n";
+
+  for (std::size_t threads = 2; threads <= std::max<std::size_t>(4, ThreadPool::default_threads());
+       threads *= 2) {
+    ThreadPool pool{threads};
+    const bool same =
+        same_tree(reference, build_render_tree(ops, viewport, text, pool));
+    const double ms =
+        time_ms([&] { (void)build_render_tree(ops, viewport, text, pool); });
+    std::cout << "threads=" << threads << " ms=" << ms
+              << " speedup=" << (ms > 0.0 ? serial_ms / ms : 0.0)
+              << (same ? " identical" : " MISMATCH") << "\n";
+  }
+}
+
+void bench_vertices(int iterations) {
+  const SizeF viewport{3840.0f, 2160.0f};
+  const auto ops = dashboard_ops(viewport);
+  SoftwareRasterizer raster;
+  SoftwareTextProvider text{raster};
+  const auto tree = build_render_tree(ops, viewport, text);
+
+  CompactVertices compact;
+  if (!compact_vertices(tree.vertices, compact)) {
+    std::cout << "vertices compact=unsupported\n";
+    return;
+  }
+  const auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    compact_vertices(tree.vertices, compact);
+  }
+  const auto t1 = std::chrono::steady_clock::now();
+  const double pack_ms =
+      std::chrono::duration<double, std::milli>(t1 - t0).count() / iterations;
+
+  auto decoded = tree;
+  for (std::size_t i = 0; i < decoded.vertices.size(); ++i) {
+    const auto &c = compact.vertices[i];
+    auto &v = decoded.vertices[i];
+    v.x = static_cast<float>(c.x) * compact.pos_scale;
+    v.y = static_cast<float>(c.y) * compact.pos_scale;
+    v.u = static_cast<float>(c.u) / 65535.0f * compact.uv_scale;
+    v.v = static_cast<float>(c.v) / 65535.0f * compact.uv_scale;
+  }
+
+  const int w = static_cast<int>(viewport.w);
+  const int h = static_cast<int>(viewport.h);
+  auto render = [&](const RenderTree &t, double &ms) {
+    raster.resize(w, h);
+    const auto r0 = std::chrono::steady_clock::now();
+    raster.clear(ColorU8{30, 30, 34, 255});
+    raster.draw_tree(t);
+    const auto r1 = std::chrono::steady_clock::now();
+    ms = std::chrono::duration<double, std::milli>(r1 - r0).count();
+    return raster.pixels();
+  };
+  double float_ms = 0.0;
+  double compact_ms = 0.0;
+  const auto a = render(tree, float_ms);
+  const auto b = render(decoded, compact_ms);
+  std::size_t differing = 0;
+  for (std::size_t i = 0; i < a.size() && i < b.size(); ++i) {
+    differing += a[i] != b[i] ? 1 : 0;
+  }
+
+  const auto float_bytes = tree.vertices.size() * sizeof(RenderVertex);
+  const auto compact_bytes = compact.vertices.size() * sizeof(CompactVertex);
+  std::cout << "vertices=" << tree.vertices.size()
+            << " float_kb=" << float_bytes / 1024
+            << " compact_kb=" << compact_bytes / 1024 << " ratio="
+            << static_cast<double>(compact_bytes) /
+                   static_cast<double>(std::max<std::size_t>(1, float_bytes))
+            << " pack_ms=" << pack_ms << " subpixel=1/"
+            << static_cast<int>(1.0f / compact.pos_scale)
+            << " uv_scale=" << compact.uv_scale << " float_frame_ms=" << float_ms
+            << " compact_frame_ms=" << compact_ms
+            << " differing_pixels=" << differing << "\n";
+}
+
+bool ends_with(const std::string &s, const char *suffix) {
+  const auto n = std::strlen(suffix);
+  return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::string out = "duorou_headless.png";
+  int width = 800;
+  int height = 600;
+  int bench = 0;
+  int bench_tree_iterations = 0;
+  int bench_vertices_iterations = 0;
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv ? argv[i] : nullptr;
+    if (!arg) {
+      continue;
+    }
+    if (std::strcmp(arg, "--out") == 0 && i + 1 < argc) {
+      out = argv[++i];
+    } else if (std::strcmp(arg, "--size") == 0 && i + 2 < argc) {
+      width = std::atoi(argv[++i]);
+      height = std::atoi(argv[++i]);
+    } else if (std::strcmp(arg, "--bench") == 0 && i + 1 < argc) {
+      bench = std::atoi(argv[++i]);
+    } else if (std::strcmp(arg, "--bench-tree") == 0 && i + 1 < argc) {
+      bench_tree_iterations = std::atoi(argv[++i]);
+    } else if (std::strcmp(arg, "--bench-vertices") == 0 && i + 1 < argc) {
+      bench_vertices_iterations = std::atoi(argv[++i]);
+    }
+  }
+  if (width <= 0 || height <= 0) {
+    return 1;
+  }
+
+  auto count = state<std::int64_t>(3);
+  ViewInstance app{[&]() {
+    return view("Column")
+        .prop("padding", 24)
+        .prop("spacing", 12)
+        .prop("cross_align", "start")
+        .children([&](auto &c) {
+          c.add(view("Text")
+                    .prop("value", std::string{"Headless render"})
+                    .prop("font_size", 24.0)
+                    .build());
+          for (std::int64_t i = 0; i < count.get(); ++i) {
+            c.add(view("Button")
+                      .key("b" + std::to_string(i))
+                      .prop("title", "Button " + std::to_string(i))
+                      .build());
+          }
+          c.add(view("Box")
+                    .prop("width", 240.0)
+                    .prop("height", 80.0)
+                    .prop("bg", 0xFFC08040)
+                    .prop("border", 0xFFFFFFFF)
+                    .prop("opacity", 0.6)
+                    .build());
+        })
+        .build();
+  }};
+
+  const SizeF viewport{static_cast<float>(width), static_cast<float>(height)};
+  app.set_viewport(viewport);
+
+  SoftwareRasterizer raster;
+  raster.resize(width, height);
+  SoftwareTextProvider text{raster};
+  RenderCommandBuffer commands;
+  build_render_commands(app.tree(), app.layout(), commands);
+  commands.cull_occluded();
+  const auto tree = build_render_tree(commands, viewport, text);
+
+  raster.clear(ColorU8{30, 30, 34, 255});
+  raster.draw_tree(tree);
+  const bool ok = ends_with(out, ".ppm") ? raster.write_ppm(out)
+                                         : raster.write_png(out);
+  std::cout << (ok ? "wrote " : "failed to write ") << out << " (" << width
+            << "x" << height << ", " << tree.batches.size() << " batches, "
+            << commands.culled_nodes << " nodes culled, "
+            << commands.culled_ops + commands.occluded_ops << " ops culled)\n";
+
+  if (bench > 0) {
+    const auto before = raster.pixels_written();
+    const auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < bench; ++i) {
+      raster.clear(ColorU8{30, 30, 34, 255});
+      raster.draw_tree(tree);
+    }
+    const auto t1 = std::chrono::steady_clock::now();
+    const double sec = std::chrono::duration<double>(t1 - t0).count();
+    const double drawn_mp =
+        static_cast<double>(raster.pixels_written() - before) * 1e-6;
+    const double mps = sec > 0.0 ? drawn_mp / sec : 0.0;
+    std::cout << "frames=" << bench << " avg_ms=" << (sec * 1000.0 / bench)
+              << " mp_per_s=" << mps
+              << " target=" << kTargetMegapixelsPerSecond
+              << (mps >= kTargetMegapixelsPerSecond ? " ok" : " below_target")
+              << "\n";
+  }
+  if (bench_tree_iterations > 0) {
+    bench_tree(bench_tree_iterations, SizeF{3840.0f, 2160.0f});
+    bench_tree(bench_tree_iterations, SizeF{7680.0f, 4320.0f});
+  }
+  if (bench_vertices_iterations > 0) {
+    bench_vertices(bench_vertices_iterations);
+  }
+  return ok ? 0 : 1;
+}